@@ -270,3 +270,242 @@ float simplex3(
     }
     return (1 + total / max) / 2;
 }
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LANES 8
+typedef __m256 vfloat;
+#define VLOAD(p) _mm256_loadu_ps(p)
+#define VSTORE(p, a) _mm256_storeu_ps(p, a)
+#define VSET(a) _mm256_set1_ps(a)
+#define VADD(a, b) _mm256_add_ps(a, b)
+#define VSUB(a, b) _mm256_sub_ps(a, b)
+#define VMUL(a, b) _mm256_mul_ps(a, b)
+#define VDIV(a, b) _mm256_div_ps(a, b)
+#define VAND(a, b) _mm256_and_ps(a, b)
+#define VGT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define VGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define VFLOOR(a) _mm256_floor_ps(a)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LANES 4
+typedef __m128 vfloat;
+#define VLOAD(p) _mm_loadu_ps(p)
+#define VSTORE(p, a) _mm_storeu_ps(p, a)
+#define VSET(a) _mm_set1_ps(a)
+#define VADD(a, b) _mm_add_ps(a, b)
+#define VSUB(a, b) _mm_sub_ps(a, b)
+#define VMUL(a, b) _mm_mul_ps(a, b)
+#define VDIV(a, b) _mm_div_ps(a, b)
+#define VAND(a, b) _mm_and_ps(a, b)
+#define VGT(a, b) _mm_cmpgt_ps(a, b)
+#define VGE(a, b) _mm_cmpge_ps(a, b)
+
+static __m128 VFLOOR(__m128 a) {
+    // sse2 has no floor; truncate, then step down where that rounded up
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f)));
+}
+#endif
+
+#ifdef LANES
+
+// each function below follows its scalar counterpart operation for
+// operation so the results are bit for bit the same; the permutation and
+// gradient lookups are done per lane
+
+#define VMASK(m) VAND(m, VSET(1.0f))
+
+static vfloat vnoise2(vfloat x, vfloat y) {
+    vfloat s = VMUL(VADD(x, y), VSET(F2));
+    vfloat i = VFLOOR(VADD(x, s));
+    vfloat j = VFLOOR(VADD(y, s));
+    vfloat t = VMUL(VADD(i, j), VSET(G2));
+    vfloat xx[3], yy[3];
+    xx[0] = VSUB(x, VSUB(i, t));
+    yy[0] = VSUB(y, VSUB(j, t));
+    vfloat i1 = VMASK(VGT(xx[0], yy[0]));
+    vfloat j1 = VSUB(VSET(1.0f), i1);
+    xx[2] = VSUB(VADD(xx[0], VSET(G2 * 2.0f)), VSET(1.0f));
+    yy[2] = VSUB(VADD(yy[0], VSET(G2 * 2.0f)), VSET(1.0f));
+    xx[1] = VADD(VSUB(xx[0], i1), VSET(G2));
+    yy[1] = VADD(VSUB(yy[0], j1), VSET(G2));
+    float fi[LANES], fj[LANES], fi1[LANES];
+    float gx[3][LANES], gy[3][LANES];
+    VSTORE(fi, i);
+    VSTORE(fj, j);
+    VSTORE(fi1, i1);
+    for (int l = 0; l < LANES; l++) {
+        int I = (int)fi[l] & 255;
+        int J = (int)fj[l] & 255;
+        int a = (int)fi1[l];
+        int b = 1 - a;
+        int g[3];
+        g[0] = PERM[I + PERM[J]] % 12;
+        g[1] = PERM[I + a + PERM[J + b]] % 12;
+        g[2] = PERM[I + 1 + PERM[J + 1]] % 12;
+        for (int c = 0; c <= 2; c++) {
+            gx[c][l] = GRAD3[g[c]][0];
+            gy[c][l] = GRAD3[g[c]][1];
+        }
+    }
+    vfloat noise[3];
+    for (int c = 0; c <= 2; c++) {
+        vfloat f = VSUB(VSUB(VSET(0.5f), VMUL(xx[c], xx[c])),
+            VMUL(yy[c], yy[c]));
+        vfloat dot = VADD(VMUL(VLOAD(gx[c]), xx[c]), VMUL(VLOAD(gy[c]), yy[c]));
+        vfloat n = VMUL(VMUL(VMUL(VMUL(f, f), f), f), dot);
+        noise[c] = VAND(VGT(f, VSET(0.0f)), n);
+    }
+    return VMUL(VADD(VADD(noise[0], noise[1]), noise[2]), VSET(70.0f));
+}
+
+static vfloat vnoise3(vfloat x, vfloat y, vfloat z) {
+    vfloat s = VMUL(VADD(VADD(x, y), z), VSET(F3));
+    vfloat i = VFLOOR(VADD(x, s));
+    vfloat j = VFLOOR(VADD(y, s));
+    vfloat k = VFLOOR(VADD(z, s));
+    vfloat t = VMUL(VADD(VADD(i, j), k), VSET(G3));
+    vfloat pos[4][3];
+    pos[0][0] = VSUB(x, VSUB(i, t));
+    pos[0][1] = VSUB(y, VSUB(j, t));
+    pos[0][2] = VSUB(z, VSUB(k, t));
+    // the six orderings of the three coordinates as 0/1 masks
+    vfloat xy = VMASK(VGE(pos[0][0], pos[0][1]));
+    vfloat yz = VMASK(VGE(pos[0][1], pos[0][2]));
+    vfloat xz = VMASK(VGE(pos[0][0], pos[0][2]));
+    float mxy[LANES], myz[LANES], mxz[LANES];
+    VSTORE(mxy, xy);
+    VSTORE(myz, yz);
+    VSTORE(mxz, xz);
+    float fi[LANES], fj[LANES], fk[LANES];
+    VSTORE(fi, i);
+    VSTORE(fj, j);
+    VSTORE(fk, k);
+    float o1[3][LANES], o2[3][LANES];
+    float gv[4][3][LANES];
+    for (int l = 0; l < LANES; l++) {
+        int a[3], b[3];
+        if (mxy[l]) {
+            if (myz[l]) {
+                ASSIGN(a, 1, 0, 0);
+                ASSIGN(b, 1, 1, 0);
+            } else if (mxz[l]) {
+                ASSIGN(a, 1, 0, 0);
+                ASSIGN(b, 1, 0, 1);
+            } else {
+                ASSIGN(a, 0, 0, 1);
+                ASSIGN(b, 1, 0, 1);
+            }
+        } else {
+            // pos[0][1] < pos[0][2] is !(pos[0][1] >= pos[0][2])
+            if (!myz[l]) {
+                ASSIGN(a, 0, 0, 1);
+                ASSIGN(b, 0, 1, 1);
+            } else if (!mxz[l]) {
+                ASSIGN(a, 0, 1, 0);
+                ASSIGN(b, 0, 1, 1);
+            } else {
+                ASSIGN(a, 0, 1, 0);
+                ASSIGN(b, 1, 1, 0);
+            }
+        }
+        int I = (int)fi[l] & 255;
+        int J = (int)fj[l] & 255;
+        int K = (int)fk[l] & 255;
+        int g[4];
+        g[0] = PERM[I + PERM[J + PERM[K]]] % 12;
+        g[1] = PERM[I + a[0] + PERM[J + a[1] + PERM[a[2] + K]]] % 12;
+        g[2] = PERM[I + b[0] + PERM[J + b[1] + PERM[b[2] + K]]] % 12;
+        g[3] = PERM[I + 1 + PERM[J + 1 + PERM[K + 1]]] % 12;
+        for (int c = 0; c < 3; c++) {
+            o1[c][l] = a[c];
+            o2[c][l] = b[c];
+            for (int n = 0; n < 4; n++) {
+                gv[n][c][l] = GRAD3[g[n]][c];
+            }
+        }
+    }
+    for (int c = 0; c <= 2; c++) {
+        pos[3][c] = VADD(VSUB(pos[0][c], VSET(1.0f)), VSET(3.0f * G3));
+        pos[2][c] = VADD(VSUB(pos[0][c], VLOAD(o2[c])), VSET(2.0f * G3));
+        pos[1][c] = VADD(VSUB(pos[0][c], VLOAD(o1[c])), VSET(G3));
+    }
+    vfloat noise[4];
+    for (int c = 0; c <= 3; c++) {
+        vfloat f = VSUB(VSUB(VSUB(VSET(0.6f),
+            VMUL(pos[c][0], pos[c][0])), VMUL(pos[c][1], pos[c][1])),
+            VMUL(pos[c][2], pos[c][2]));
+        vfloat dot = VADD(VADD(
+            VMUL(pos[c][0], VLOAD(gv[c][0])),
+            VMUL(pos[c][1], VLOAD(gv[c][1]))),
+            VMUL(pos[c][2], VLOAD(gv[c][2])));
+        vfloat n = VMUL(VMUL(VMUL(VMUL(f, f), f), f), dot);
+        noise[c] = VAND(VGT(f, VSET(0.0f)), n);
+    }
+    return VMUL(VADD(VADD(VADD(noise[0], noise[1]), noise[2]), noise[3]),
+        VSET(32.0f));
+}
+
+#endif
+
+void simplex2_batch(
+    float *out, const float *x, const float *y, int count,
+    int octaves, float persistence, float lacunarity)
+{
+    int n = 0;
+#ifdef LANES
+    for (; n + LANES <= count; n += LANES) {
+        vfloat vx = VLOAD(x + n);
+        vfloat vy = VLOAD(y + n);
+        float freq = 1.0f;
+        float amp = 1.0f;
+        float max = 1.0f;
+        vfloat total = vnoise2(vx, vy);
+        for (int i = 1; i < octaves; i++) {
+            freq *= lacunarity;
+            amp *= persistence;
+            max += amp;
+            vfloat f = VSET(freq);
+            total = VADD(total,
+                VMUL(vnoise2(VMUL(vx, f), VMUL(vy, f)), VSET(amp)));
+        }
+        total = VDIV(VADD(VSET(1.0f), VDIV(total, VSET(max))), VSET(2.0f));
+        VSTORE(out + n, total);
+    }
+#endif
+    for (; n < count; n++) {
+        out[n] = simplex2(x[n], y[n], octaves, persistence, lacunarity);
+    }
+}
+
+void simplex3_batch(
+    float *out, const float *x, const float *y, const float *z, int count,
+    int octaves, float persistence, float lacunarity)
+{
+    int n = 0;
+#ifdef LANES
+    for (; n + LANES <= count; n += LANES) {
+        vfloat vx = VLOAD(x + n);
+        vfloat vy = VLOAD(y + n);
+        vfloat vz = VLOAD(z + n);
+        float freq = 1.0f;
+        float amp = 1.0f;
+        float max = 1.0f;
+        vfloat total = vnoise3(vx, vy, vz);
+        for (int i = 1; i < octaves; i++) {
+            freq *= lacunarity;
+            amp *= persistence;
+            max += amp;
+            vfloat f = VSET(freq);
+            total = VADD(total, VMUL(
+                vnoise3(VMUL(vx, f), VMUL(vy, f), VMUL(vz, f)), VSET(amp)));
+        }
+        total = VDIV(VADD(VSET(1.0f), VDIV(total, VSET(max))), VSET(2.0f));
+        VSTORE(out + n, total);
+    }
+#endif
+    for (; n < count; n++) {
+        out[n] = simplex3(x[n], y[n], z[n], octaves, persistence, lacunarity);
+    }
+}
@@ -37,4 +37,14 @@ float simplex3(
     float x, float y, float z,
     int octaves, float persistence, float lacunarity);
 
+// the same values for count points at once, SSE2 or AVX2 when available
+
+void simplex2_batch(
+    float *out, const float *x, const float *y, int count,
+    int octaves, float persistence, float lacunarity);
+
+void simplex3_batch(
+    float *out, const float *x, const float *y, const float *z, int count,
+    int octaves, float persistence, float lacunarity);
+
 #endif
@@ -45,6 +45,7 @@ LIGHT = 'L'
 NICK = 'N'
 POSITION = 'P'
 REDRAW = 'R'
+REGION = 'G'
 SIGN = 'S'
 TALK = 'T'
 TIME = 'E'
@@ -175,6 +176,7 @@ class Model(object):
             AUTHENTICATE: self.on_authenticate,
             CHUNK: self.on_chunk,
             BLOCK: self.on_block,
+            REGION: self.on_region,
             LIGHT: self.on_light,
             POSITION: self.on_position,
             TALK: self.on_talk,
@@ -431,6 +433,14 @@ class Model(object):
                 'x = :x and y = :y and z = :z;'
             )
             self.execute(query, dict(x=x, y=y, z=z))
+    def on_region(self, client, x, y, z, w, count):
+        x, y, z, w, count = map(int, (x, y, z, w, count))
+        for i in range(max(0, min(count, CHUNK_SIZE * 8))):
+            previous = self.get_block(x, y, z + i)
+            if previous and previous not in INDESTRUCTIBLE_ITEMS:
+                self.on_block(client, x, y, z + i, 0)
+            if w:
+                self.on_block(client, x, y, z + i, w)
     def on_light(self, client, x, y, z, w):
         x, y, z, w = map(int, (x, y, z, w))
         p, q = chunked(x), chunked(z)
@@ -16,7 +16,14 @@ varying float diffuse;
 const float pi = 3.14159265;
 
 void main() {
-    vec3 color = vec3(texture2D(sampler, fragment_uv));
+    vec2 uv = fragment_uv;
+    if (uv.x >= 64.0) {
+        // greedy quads carry (tile + 1) * 64 plus a repeating block offset
+        vec2 tile = floor(uv / 64.0);
+        vec2 offset = fract(uv - tile * 64.0);
+        uv = (tile - 1.0 + mix(vec2(1.0 / 128.0), vec2(127.0 / 128.0), offset)) / 16.0;
+    }
+    vec3 color = vec3(texture2D(sampler, uv));
     if (color == vec3(1.0, 0.0, 1.0)) {
         discard;
     }
@@ -0,0 +1,54 @@
+#version 120
+
+uniform mat4 matrix;
+uniform vec3 camera;
+uniform vec3 origin;
+uniform float fog_distance;
+uniform int ortho;
+
+attribute vec3 position;
+attribute vec2 normal;
+attribute vec4 uv;
+
+varying vec2 fragment_uv;
+varying float fragment_ao;
+varying float fragment_light;
+varying float fog_factor;
+varying float fog_height;
+varying float diffuse;
+
+const float pi = 3.14159265;
+const vec3 light_direction = normalize(vec3(-1.0, 1.0, -1.0));
+
+vec3 unpack_normal(float value) {
+    if (value > 240.5) {
+        return vec3(0.0, -1.0, 0.0);
+    }
+    if (value > 239.5) {
+        return vec3(0.0, 1.0, 0.0);
+    }
+    float angle = value / 240.0 * 2.0 * pi;
+    return vec3(cos(angle), 0.0, sin(angle));
+}
+
+void main() {
+    vec4 world = vec4(origin + position / 64.0, 1.0);
+    gl_Position = matrix * world;
+    float tile = normal.y;
+    vec2 cell = vec2(mod(tile, 16.0), floor(tile / 16.0));
+    fragment_uv = (cell + 1.0) * 64.0 + uv.xy;
+    fragment_ao = 0.3 + (1.0 - uv.z / 32.0) * 0.7;
+    fragment_light = uv.w / 60.0;
+    diffuse = max(0.0, dot(unpack_normal(normal.x), light_direction));
+    if (bool(ortho)) {
+        fog_factor = 0.0;
+        fog_height = 0.0;
+    }
+    else {
+        float camera_distance = distance(camera, vec3(world));
+        fog_factor = pow(clamp(camera_distance / fog_distance, 0.0, 1.0), 4.0);
+        float dy = world.y - camera.y;
+        float dx = distance(world.xz, camera.xz);
+        fog_height = (atan(dy, dx) + pi / 2) / pi;
+    }
+}
@@ -0,0 +1,231 @@
+#include "ao.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// neighbor indices are (dx + 1) * 9 + (dy + 1) * 3 + (dz + 1), the same
+// order occlusion() in main.c uses
+static const int lookup3[6][4][3] = {
+    {{0, 1, 3}, {2, 1, 5}, {6, 3, 7}, {8, 5, 7}},
+    {{18, 19, 21}, {20, 19, 23}, {24, 21, 25}, {26, 23, 25}},
+    {{6, 7, 15}, {8, 7, 17}, {24, 15, 25}, {26, 17, 25}},
+    {{0, 1, 9}, {2, 1, 11}, {18, 9, 19}, {20, 11, 19}},
+    {{0, 3, 9}, {6, 3, 15}, {18, 9, 21}, {24, 15, 21}},
+    {{2, 5, 11}, {8, 5, 17}, {20, 11, 23}, {26, 17, 23}}
+};
+static const int lookup4[6][4][4] = {
+    {{0, 1, 3, 4}, {1, 2, 4, 5}, {3, 4, 6, 7}, {4, 5, 7, 8}},
+    {{18, 19, 21, 22}, {19, 20, 22, 23}, {21, 22, 24, 25}, {22, 23, 25, 26}},
+    {{6, 7, 15, 16}, {7, 8, 16, 17}, {15, 16, 24, 25}, {16, 17, 25, 26}},
+    {{0, 1, 9, 10}, {1, 2, 10, 11}, {9, 10, 18, 19}, {10, 11, 19, 20}},
+    {{0, 3, 9, 12}, {3, 6, 12, 15}, {9, 12, 18, 21}, {12, 15, 21, 24}},
+    {{2, 5, 11, 14}, {5, 8, 14, 17}, {11, 14, 20, 23}, {14, 17, 23, 26}}
+};
+
+const char *ao_kernel() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void ao_shade(
+    char *shade, const char *opaque, const char *highest,
+    int size, int height, int lo, int hi)
+{
+    // shade is 8 - (distance to the first opaque voxel at or above, up
+    // to 7), or 0, for voxels at or below the highest block of their column
+    int layer = size * size;
+    for (int x = lo; x <= hi; x++) {
+        int z = lo;
+#if defined(__SSE2__)
+        for (; z + 16 <= hi + 1; z += 16) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i one = _mm_set1_epi8(1);
+            const __m128i eight = _mm_set1_epi8(8);
+            __m128i top = _mm_loadu_si128(
+                (const __m128i *)(highest + x * size + z));
+            __m128i d = eight;
+            for (int y = height - 1; y >= 0; y--) {
+                int i = y * layer + x * size + z;
+                __m128i o = _mm_loadu_si128((const __m128i *)(opaque + i));
+                __m128i clear = _mm_cmpeq_epi8(o, zero);
+                d = _mm_and_si128(clear, _mm_min_epu8(_mm_add_epi8(d, one), eight));
+                __m128i s = _mm_sub_epi8(eight, d);
+                if (y > 127) {
+                    s = zero;
+                }
+                else {
+                    __m128i above = _mm_cmpgt_epi8(_mm_set1_epi8(y), top);
+                    s = _mm_andnot_si128(above, s);
+                }
+                _mm_storeu_si128((__m128i *)(shade + i), s);
+            }
+        }
+#endif
+        for (; z <= hi; z++) {
+            int d = 8;
+            for (int y = height - 1; y >= 0; y--) {
+                int i = y * layer + x * size + z;
+                d = opaque[i] ? 0 : (d < 8 ? d + 1 : 8);
+                shade[i] = y <= highest[x * size + z] ? 8 - d : 0;
+            }
+        }
+    }
+}
+
+#if defined(__AVX2__)
+
+static void ao_row_avx2(
+    AoRow *row, const char *opaque, const char *light, const char *shade,
+    int base, const int offsets[27], int lane)
+{
+    #define LOAD(a, k) _mm256_loadu_si256( \
+        (const __m256i *)((a) + base + offsets[k]))
+    const __m256i limit = _mm256_set1_epi8(32);
+    const __m256i full = _mm256_set1_epi8(15);
+    __m256i is_light = _mm256_cmpeq_epi8(LOAD(light, 13), full);
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 4; j++) {
+            const int *a = lookup3[i][j];
+            const int *b = lookup4[i][j];
+            __m256i corner = LOAD(opaque, a[0]);
+            __m256i side1 = LOAD(opaque, a[1]);
+            __m256i side2 = LOAD(opaque, a[2]);
+            __m256i both = _mm256_and_si256(side1, side2);
+            __m256i value = _mm256_max_epu8(
+                _mm256_add_epi8(_mm256_add_epi8(corner, side1), side2),
+                _mm256_add_epi8(_mm256_add_epi8(both, both), both));
+            __m256i shades = _mm256_add_epi8(
+                _mm256_add_epi8(LOAD(shade, b[0]), LOAD(shade, b[1])),
+                _mm256_add_epi8(LOAD(shade, b[2]), LOAD(shade, b[3])));
+            __m256i ao = _mm256_min_epu8(limit, _mm256_add_epi8(
+                _mm256_slli_epi16(value, 3), shades));
+            __m256i lights = _mm256_add_epi8(
+                _mm256_add_epi8(LOAD(light, b[0]), LOAD(light, b[1])),
+                _mm256_add_epi8(LOAD(light, b[2]), LOAD(light, b[3])));
+            lights = _mm256_or_si256(lights, is_light);
+            _mm256_storeu_si256(
+                (__m256i *)(row->ao[i * 4 + j] + lane), ao);
+            _mm256_storeu_si256(
+                (__m256i *)(row->light[i * 4 + j] + lane), lights);
+        }
+    }
+    #undef LOAD
+}
+
+#elif defined(__SSE2__)
+
+static void ao_row_sse2(
+    AoRow *row, const char *opaque, const char *light, const char *shade,
+    int base, const int offsets[27], int lane)
+{
+    #define LOAD(a, k) _mm_loadu_si128( \
+        (const __m128i *)((a) + base + offsets[k]))
+    const __m128i limit = _mm_set1_epi8(32);
+    const __m128i full = _mm_set1_epi8(15);
+    __m128i is_light = _mm_cmpeq_epi8(LOAD(light, 13), full);
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 4; j++) {
+            const int *a = lookup3[i][j];
+            const int *b = lookup4[i][j];
+            __m128i corner = LOAD(opaque, a[0]);
+            __m128i side1 = LOAD(opaque, a[1]);
+            __m128i side2 = LOAD(opaque, a[2]);
+            __m128i both = _mm_and_si128(side1, side2);
+            __m128i value = _mm_max_epu8(
+                _mm_add_epi8(_mm_add_epi8(corner, side1), side2),
+                _mm_add_epi8(_mm_add_epi8(both, both), both));
+            __m128i shades = _mm_add_epi8(
+                _mm_add_epi8(LOAD(shade, b[0]), LOAD(shade, b[1])),
+                _mm_add_epi8(LOAD(shade, b[2]), LOAD(shade, b[3])));
+            __m128i ao = _mm_min_epu8(limit, _mm_add_epi8(
+                _mm_slli_epi16(value, 3), shades));
+            __m128i lights = _mm_add_epi8(
+                _mm_add_epi8(LOAD(light, b[0]), LOAD(light, b[1])),
+                _mm_add_epi8(LOAD(light, b[2]), LOAD(light, b[3])));
+            lights = _mm_or_si128(lights, is_light);
+            _mm_storeu_si128((__m128i *)(row->ao[i * 4 + j] + lane), ao);
+            _mm_storeu_si128(
+                (__m128i *)(row->light[i * 4 + j] + lane), lights);
+        }
+    }
+    #undef LOAD
+}
+
+#endif
+
+static void ao_row_scalar(
+    AoRow *row, const char *opaque, const char *light, const char *shade,
+    int base, const int offsets[27], int lane)
+{
+    const char *o = opaque + base;
+    const char *l = light + base;
+    const char *s = shade + base;
+    int is_light = l[offsets[13]] == 15;
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 4; j++) {
+            const int *a = lookup3[i][j];
+            const int *b = lookup4[i][j];
+            int corner = o[offsets[a[0]]];
+            int side1 = o[offsets[a[1]]];
+            int side2 = o[offsets[a[2]]];
+            int value = side1 && side2 ? 3 : corner + side1 + side2;
+            int shades = 0;
+            int lights = 0;
+            for (int k = 0; k < 4; k++) {
+                shades += s[offsets[b[k]]];
+                lights += l[offsets[b[k]]];
+            }
+            int ao = value * 8 + shades;
+            row->ao[i * 4 + j][lane] = ao < 32 ? ao : 32;
+            row->light[i * 4 + j][lane] = is_light ? AO_LIGHT : lights;
+        }
+    }
+}
+
+void ao_row(
+    AoRow *row, const char *opaque, const char *light, const char *shade,
+    int size, int x, int y, int z, int count)
+{
+    int offsets[27];
+    int index = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                offsets[index++] = dy * size * size + dx * size + dz;
+            }
+        }
+    }
+    int base = y * size * size + x * size + z;
+    int lane = 0;
+#if defined(__AVX2__)
+    for (; lane + 32 <= count; lane += 32) {
+        ao_row_avx2(row, opaque, light, shade, base + lane, offsets, lane);
+    }
+#elif defined(__SSE2__)
+    for (; lane + 16 <= count; lane += 16) {
+        ao_row_sse2(row, opaque, light, shade, base + lane, offsets, lane);
+    }
+#endif
+    for (; lane < count; lane++) {
+        ao_row_scalar(row, opaque, light, shade, base + lane, offsets, lane);
+    }
+}
+
+void ao_unpack(AoRow *row, int i, float ao[6][4], float light[6][4]) {
+    for (int a = 0; a < 6; a++) {
+        for (int b = 0; b < 4; b++) {
+            int value = row->light[a * 4 + b][i];
+            float light_sum = value == AO_LIGHT ? 15 * 4 * 10 : value;
+            ao[a][b] = row->ao[a * 4 + b][i] / 32.0;
+            light[a][b] = light_sum / 15.0 / 4.0;
+        }
+    }
+}
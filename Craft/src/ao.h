@@ -0,0 +1,27 @@
+#ifndef _ao_h_
+#define _ao_h_
+
+// ambient occlusion and light for rows of voxels along z, read from the
+// y * size * size + x * size + z arrays that compute_chunk fills in;
+// everything is kept in small integers so the SSE2 and AVX2 kernels match
+// the scalar one exactly
+
+#define AO_ROW 32
+#define AO_CORNERS 24
+#define AO_LIGHT 255
+
+typedef struct {
+    unsigned char ao[AO_CORNERS][AO_ROW];
+    unsigned char light[AO_CORNERS][AO_ROW];
+} AoRow;
+
+const char *ao_kernel();
+void ao_shade(
+    char *shade, const char *opaque, const char *highest,
+    int size, int height, int lo, int hi);
+void ao_row(
+    AoRow *row, const char *opaque, const char *light, const char *shade,
+    int size, int x, int y, int z, int count);
+void ao_unpack(AoRow *row, int i, float ao[6][4], float light[6][4]);
+
+#endif
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+void arena_alloc(Arena *arena, int capacity) {
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->count = 1;
+    arena->allocated = 16;
+    arena->ranges = (ArenaRange *)calloc(arena->allocated, sizeof(ArenaRange));
+    arena->ranges[0].offset = 0;
+    arena->ranges[0].size = capacity;
+}
+
+void arena_free(Arena *arena) {
+    free(arena->ranges);
+}
+
+int arena_take(Arena *arena, int size) {
+    // the free ranges are kept sorted by offset, so the first one that
+    // fits is also the lowest, which keeps live ranges packed together
+    for (int i = 0; i < arena->count; i++) {
+        ArenaRange *range = arena->ranges + i;
+        if (range->size < size) {
+            continue;
+        }
+        int offset = range->offset;
+        range->offset += size;
+        range->size -= size;
+        if (!range->size) {
+            memmove(range, range + 1,
+                sizeof(ArenaRange) * (arena->count - i - 1));
+            arena->count--;
+        }
+        arena->used += size;
+        return offset;
+    }
+    return -1;
+}
+
+void arena_give(Arena *arena, int offset, int size) {
+    int i = 0;
+    while (i < arena->count && arena->ranges[i].offset < offset) {
+        i++;
+    }
+    arena->used -= size;
+    ArenaRange *prev = i ? arena->ranges + i - 1 : 0;
+    ArenaRange *next = i < arena->count ? arena->ranges + i : 0;
+    int join_prev = prev && prev->offset + prev->size == offset;
+    int join_next = next && offset + size == next->offset;
+    if (join_prev && join_next) {
+        prev->size += size + next->size;
+        memmove(next, next + 1, sizeof(ArenaRange) * (arena->count - i - 1));
+        arena->count--;
+        return;
+    }
+    if (join_prev) {
+        prev->size += size;
+        return;
+    }
+    if (join_next) {
+        next->offset = offset;
+        next->size += size;
+        return;
+    }
+    if (arena->count == arena->allocated) {
+        arena->allocated *= 2;
+        arena->ranges = (ArenaRange *)realloc(
+            arena->ranges, sizeof(ArenaRange) * arena->allocated);
+    }
+    memmove(arena->ranges + i + 1, arena->ranges + i,
+        sizeof(ArenaRange) * (arena->count - i));
+    arena->ranges[i].offset = offset;
+    arena->ranges[i].size = size;
+    arena->count++;
+}
@@ -0,0 +1,26 @@
+#ifndef _arena_h_
+#define _arena_h_
+
+// first fit sub-allocator for the ranges of one large buffer; it only does
+// the bookkeeping, in whatever units the caller counts, and never touches
+// the memory it hands out
+
+typedef struct {
+    int offset;
+    int size;
+} ArenaRange;
+
+typedef struct {
+    int capacity;
+    int used;
+    int count;
+    int allocated;
+    ArenaRange *ranges;
+} Arena;
+
+void arena_alloc(Arena *arena, int capacity);
+void arena_free(Arena *arena);
+int arena_take(Arena *arena, int size);
+void arena_give(Arena *arena, int offset, int size);
+
+#endif
@@ -0,0 +1,155 @@
+#include <stdlib.h>
+#include <string.h>
+#include "blob.h"
+#include "config.h"
+#include "lodepng.h"
+
+void edit_list_alloc(EditList *list, int capacity) {
+    list->capacity = capacity;
+    list->size = 0;
+    list->data = (Edit *)calloc(capacity, sizeof(Edit));
+}
+
+void edit_list_free(EditList *list) {
+    free(list->data);
+}
+
+void edit_list_grow(EditList *list) {
+    EditList new_list;
+    edit_list_alloc(&new_list, list->capacity ? list->capacity * 2 : 64);
+    memcpy(new_list.data, list->data, list->size * sizeof(Edit));
+    free(list->data);
+    list->capacity = new_list.capacity;
+    list->data = new_list.data;
+}
+
+void edit_list_add(EditList *list, int x, int y, int z, int w) {
+    if (list->size == list->capacity) {
+        edit_list_grow(list);
+    }
+    Edit *e = list->data + list->size;
+    e->x = x;
+    e->y = y;
+    e->z = z;
+    e->w = w;
+    e->seq = list->size++;
+}
+
+static int edit_compare(const void *a, const void *b) {
+    const Edit *e1 = (const Edit *)a;
+    const Edit *e2 = (const Edit *)b;
+    if (e1->y != e2->y) {
+        return e1->y < e2->y ? -1 : 1;
+    }
+    if (e1->x != e2->x) {
+        return e1->x < e2->x ? -1 : 1;
+    }
+    if (e1->z != e2->z) {
+        return e1->z < e2->z ? -1 : 1;
+    }
+    return e1->seq < e2->seq ? -1 : (e1->seq > e2->seq);
+}
+
+void edit_list_merge(EditList *list) {
+    // sorts by position and keeps only the latest edit at each one
+    qsort(list->data, list->size, sizeof(Edit), edit_compare);
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < list->size; i++) {
+        Edit *e = list->data + i;
+        if (i + 1 < list->size) {
+            Edit *next = e + 1;
+            if (next->x == e->x && next->y == e->y && next->z == e->z) {
+                continue;
+            }
+        }
+        list->data[count] = *e;
+        list->data[count].seq = count;
+        count++;
+    }
+    list->size = count;
+}
+
+static void put_short(unsigned char *data, int value) {
+    data[0] = value & 0xff;
+    data[1] = (value >> 8) & 0xff;
+}
+
+static int get_short(const unsigned char *data) {
+    return (short)(data[0] | (data[1] << 8));
+}
+
+int blob_encode(
+    EditList *list, int p, int q, unsigned char **data, size_t *size)
+{
+    int n = list->size;
+    size_t length = 4 + n * 7;
+    unsigned char *raw = (unsigned char *)malloc(length);
+    raw[0] = n & 0xff;
+    raw[1] = (n >> 8) & 0xff;
+    raw[2] = (n >> 16) & 0xff;
+    raw[3] = (n >> 24) & 0xff;
+    unsigned char *xs = raw + 4;
+    unsigned char *ys = xs + n * 2;
+    unsigned char *zs = ys + n * 2;
+    unsigned char *ws = zs + n * 2;
+    for (int i = 0; i < n; i++) {
+        Edit *e = list->data + i;
+        put_short(xs + i * 2, e->x - p * CHUNK_SIZE);
+        put_short(ys + i * 2, e->y);
+        put_short(zs + i * 2, e->z - q * CHUNK_SIZE);
+        ws[i] = e->w & 0xff;
+    }
+    unsigned char *packed = 0;
+    size_t packed_size = 0;
+    unsigned error = lodepng_zlib_compress(
+        &packed, &packed_size, raw, length,
+        &lodepng_default_compress_settings);
+    free(raw);
+    if (error) {
+        free(packed);
+        return 0;
+    }
+    *size = packed_size + 1;
+    *data = (unsigned char *)malloc(*size);
+    (*data)[0] = BLOB_VERSION;
+    memcpy(*data + 1, packed, packed_size);
+    free(packed);
+    return 1;
+}
+
+int blob_decode(
+    EditList *list, int p, int q, const unsigned char *data, size_t size)
+{
+    // appends to the list, so decoding the saved blob first and then
+    // adding newer edits leaves the newer ones last for edit_list_merge
+    if (size < 1 || data[0] != BLOB_VERSION) {
+        return 0;
+    }
+    unsigned char *raw = 0;
+    size_t length = 0;
+    unsigned error = lodepng_zlib_decompress(
+        &raw, &length, data + 1, size - 1,
+        &lodepng_default_decompress_settings);
+    if (error || length < 4) {
+        free(raw);
+        return 0;
+    }
+    int n = raw[0] | (raw[1] << 8) | (raw[2] << 16) | (raw[3] << 24);
+    if (n < 0 || length != 4 + (size_t)n * 7) {
+        free(raw);
+        return 0;
+    }
+    const unsigned char *xs = raw + 4;
+    const unsigned char *ys = xs + n * 2;
+    const unsigned char *zs = ys + n * 2;
+    const unsigned char *ws = zs + n * 2;
+    for (int i = 0; i < n; i++) {
+        edit_list_add(list,
+            get_short(xs + i * 2) + p * CHUNK_SIZE,
+            get_short(ys + i * 2),
+            get_short(zs + i * 2) + q * CHUNK_SIZE,
+            (signed char)ws[i]);
+    }
+    free(raw);
+    return 1;
+}
@@ -0,0 +1,36 @@
+#ifndef _blob_h_
+#define _blob_h_
+
+#include <stddef.h>
+
+// the saved edits of one chunk, packed into a single compressed blob;
+// positions are stored relative to the chunk in separate planes so runs
+// of similar values sit next to each other for the compressor
+
+#define BLOB_VERSION 1
+
+typedef struct {
+    int x;
+    int y;
+    int z;
+    int w;
+    int seq;
+} Edit;
+
+typedef struct {
+    unsigned int capacity;
+    unsigned int size;
+    Edit *data;
+} EditList;
+
+void edit_list_alloc(EditList *list, int capacity);
+void edit_list_free(EditList *list);
+void edit_list_grow(EditList *list);
+void edit_list_add(EditList *list, int x, int y, int z, int w);
+void edit_list_merge(EditList *list);
+int blob_encode(
+    EditList *list, int p, int q, unsigned char **data, size_t *size);
+int blob_decode(
+    EditList *list, int p, int q, const unsigned char *data, size_t size);
+
+#endif
@@ -0,0 +1,175 @@
+#ifdef _WIN32
+    #include <windows.h>
+    #include <direct.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include "cache.h"
+#include "tinycthread.h"
+
+#define CACHE_MAGIC 0x6873656d
+#define CACHE_PATH_LENGTH 512
+// a slash, two ints of up to 11 characters, two dots and the extension
+#define CACHE_NAME_LENGTH 32
+
+typedef struct {
+    unsigned int magic;
+    int p;
+    int q;
+    int faces;
+    int miny;
+    int maxy;
+    unsigned long long key;
+    unsigned long long size;
+} CacheHeader;
+
+static int cache_enabled = 0;
+static char cache_path[CACHE_PATH_LENGTH];
+static int mtx_ready = 0;
+static mtx_t mtx;
+
+void cache_enable(const char *path) {
+    snprintf(cache_path, CACHE_PATH_LENGTH, "%s", path);
+#ifdef _WIN32
+    _mkdir(cache_path);
+#else
+    mkdir(cache_path, 0755);
+#endif
+    if (!mtx_ready) {
+        mtx_init(&mtx, mtx_plain);
+        mtx_ready = 1;
+    }
+    cache_enabled = 1;
+}
+
+void cache_disable() {
+    cache_enabled = 0;
+}
+
+int get_cache_enabled() {
+    return cache_enabled;
+}
+
+static void *cache_map(const char *path, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    LARGE_INTEGER length;
+    void *base = 0;
+    if (GetFileSizeEx(file, &length) && length.QuadPart) {
+        HANDLE mapping = CreateFileMappingA(
+            file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            // the view keeps the file alive after both handles are closed
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = (size_t)length.QuadPart;
+    }
+    CloseHandle(file);
+    return base;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat info;
+    void *base = 0;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        base = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            base = 0;
+        }
+        *size = info.st_size;
+    }
+    close(fd);
+    return base;
+#endif
+}
+
+static void cache_unmap(void *base, size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+#else
+    munmap(base, size);
+#endif
+}
+
+int cache_load(CacheHit *hit, int p, int q, unsigned long long key) {
+    hit->base = 0;
+    if (!cache_enabled) {
+        return 0;
+    }
+    char path[CACHE_PATH_LENGTH + CACHE_NAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/%d.%d.mesh", cache_path, p, q);
+    size_t size = 0;
+    void *base = cache_map(path, &size);
+    if (!base) {
+        return 0;
+    }
+    CacheHeader *header = (CacheHeader *)base;
+    if (size < sizeof(CacheHeader) ||
+        header->magic != CACHE_MAGIC || header->key != key ||
+        header->p != p || header->q != q ||
+        header->size != size - sizeof(CacheHeader))
+    {
+        cache_unmap(base, size);
+        return 0;
+    }
+    hit->base = base;
+    hit->size = size;
+    hit->data = header + 1;
+    hit->faces = header->faces;
+    hit->miny = header->miny;
+    hit->maxy = header->maxy;
+    return 1;
+}
+
+void cache_release(CacheHit *hit) {
+    if (hit->base) {
+        cache_unmap(hit->base, hit->size);
+        hit->base = 0;
+    }
+}
+
+void cache_store(
+    int p, int q, unsigned long long key,
+    int faces, int miny, int maxy, void *data, size_t size)
+{
+    if (!cache_enabled) {
+        return;
+    }
+    CacheHeader header = {
+        CACHE_MAGIC, p, q, faces, miny, maxy, key, size};
+    char path[CACHE_PATH_LENGTH + CACHE_NAME_LENGTH];
+    char temp[CACHE_PATH_LENGTH + CACHE_NAME_LENGTH];
+    snprintf(path, sizeof(path), "%s/%d.%d.mesh", cache_path, p, q);
+    snprintf(temp, sizeof(temp), "%s/%d.%d.tmp", cache_path, p, q);
+    // written aside and renamed so a reader never maps a partial file
+    mtx_lock(&mtx);
+    FILE *file = fopen(temp, "wb");
+    if (file) {
+        int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+        if (size) {
+            ok = ok && fwrite(data, size, 1, file) == 1;
+        }
+        ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+        remove(path);
+#endif
+        if (!ok || rename(temp, path)) {
+            remove(temp);
+        }
+    }
+    mtx_unlock(&mtx);
+}
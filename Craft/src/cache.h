@@ -0,0 +1,28 @@
+#ifndef _cache_h_
+#define _cache_h_
+
+#include <stddef.h>
+
+// finished chunk meshes kept on disk, one file per chunk, so a chunk whose
+// inputs have not changed since the last run can skip meshing entirely;
+// hits are memory mapped and handed to the gpu without a copy
+
+typedef struct {
+    void *base;
+    size_t size;
+    void *data;
+    int faces;
+    int miny;
+    int maxy;
+} CacheHit;
+
+void cache_enable(const char *path);
+void cache_disable();
+int get_cache_enabled();
+int cache_load(CacheHit *hit, int p, int q, unsigned long long key);
+void cache_release(CacheHit *hit);
+void cache_store(
+    int p, int q, unsigned long long key,
+    int faces, int miny, int maxy, void *data, size_t size);
+
+#endif
@@ -12,20 +12,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include "client.h"
+#include "stream.h"
 #include "tinycthread.h"
 
 #define QUEUE_SIZE 1048576
-#define RECV_SIZE 4096
 
 static int client_enabled = 0;
 static int running = 0;
 static int sd = 0;
 static int bytes_sent = 0;
 static int bytes_received = 0;
-static char *queue = 0;
-static int qsize = 0;
+static Stream stream;
 static thrd_t recv_thread;
-static mtx_t mutex;
 
 void client_enable() {
     client_enabled = 1;
@@ -122,6 +120,16 @@ void client_block(int x, int y, int z, int w) {
     client_send(buffer);
 }
 
+void client_region(int x, int y, int z, int w, int count) {
+    // count blocks of type w from (x, y, z) along +z
+    if (!client_enabled) {
+        return;
+    }
+    char buffer[1024];
+    snprintf(buffer, 1024, "G,%d,%d,%d,%d,%d\n", x, y, z, w, count);
+    client_send(buffer);
+}
+
 void client_light(int x, int y, int z, int w) {
     if (!client_enabled) {
         return;
@@ -156,31 +164,24 @@ char *client_recv() {
     if (!client_enabled) {
         return 0;
     }
-    char *result = 0;
-    mtx_lock(&mutex);
-    char *p = queue + qsize - 1;
-    while (p >= queue && *p != '\n') {
-        p--;
-    }
-    if (p >= queue) {
-        int length = p - queue + 1;
-        result = malloc(sizeof(char) * (length + 1));
-        memcpy(result, queue, sizeof(char) * length);
-        result[length] = '\0';
-        int remaining = qsize - length;
-        memmove(queue, p + 1, remaining);
-        qsize -= length;
-        bytes_received += length;
+    int length;
+    char *line = stream_line(&stream, &length);
+    if (line) {
+        bytes_received += length + 1;
     }
-    mtx_unlock(&mutex);
-    return result;
+    return line;
 }
 
 int recv_worker(void *arg) {
-    char *data = malloc(sizeof(char) * RECV_SIZE);
     while (1) {
+        char *data;
+        int size = stream_reserve(&stream, &data);
+        if (!size) {
+            sleep(0);
+            continue;
+        }
         int length;
-        if ((length = recv(sd, data, RECV_SIZE - 1, 0)) <= 0) {
+        if ((length = recv(sd, data, size, 0)) <= 0) {
             if (running) {
                 perror("recv");
                 exit(1);
@@ -189,23 +190,8 @@ int recv_worker(void *arg) {
                 break;
             }
         }
-        data[length] = '\0';
-        while (1) {
-            int done = 0;
-            mtx_lock(&mutex);
-            if (qsize + length < QUEUE_SIZE) {
-                memcpy(queue + qsize, data, sizeof(char) * (length + 1));
-                qsize += length;
-                done = 1;
-            }
-            mtx_unlock(&mutex);
-            if (done) {
-                break;
-            }
-            sleep(0);
-        }
+        stream_commit(&stream, length);
     }
-    free(data);
     return 0;
 }
 
@@ -238,9 +224,7 @@ void client_start() {
         return;
     }
     running = 1;
-    queue = (char *)calloc(QUEUE_SIZE, sizeof(char));
-    qsize = 0;
-    mtx_init(&mutex, mtx_plain);
+    stream_alloc(&stream, QUEUE_SIZE);
     if (thrd_create(&recv_thread, recv_worker, NULL) != thrd_success) {
         perror("thrd_create");
         exit(1);
@@ -257,9 +241,7 @@ void client_stop() {
     //     perror("thrd_join");
     //     exit(1);
     // }
-    // mtx_destroy(&mutex);
-    qsize = 0;
-    free(queue);
+    stream_free(&stream);
     // printf("Bytes Sent: %d, Bytes Received: %d\n",
     //     bytes_sent, bytes_received);
 }
@@ -0,0 +1,32 @@
+#ifndef _common_h_
+#define _common_h_
+
+// helpers that need neither GL nor GLFW, so that tools built without a
+// window can share them with the game
+
+#include "config.h"
+
+#define PI 3.14159265359
+#define DEGREES(radians) ((radians) * 180 / PI)
+#define RADIANS(degrees) ((degrees) * PI / 180)
+#define ABS(x) ((x) < 0 ? (-(x)) : (x))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define SIGN(x) (((x) > 0) - ((x) < 0))
+
+#if DEBUG
+    #define LOG(...) printf(__VA_ARGS__)
+#else
+    #define LOG(...)
+#endif
+
+int rand_int(int n);
+double rand_double();
+int get_cpu_count();
+char *load_file(const char *path);
+char *tokenize(char *str, const char *delim, char **key);
+int char_width(char input);
+int string_width(const char *input);
+int wrap(const char *input, int max_width, char *output, int max_length);
+
+#endif
@@ -23,6 +23,7 @@
 #define SHOW_CROSSHAIRS 1
 #define SHOW_WIREFRAME 1
 #define SHOW_INFO_TEXT 1
+#define SHOW_DEBUG_TEXT 0
 #define SHOW_CHAT_TEXT 1
 #define SHOW_PLAYER_NAMES 1
 
@@ -50,5 +51,17 @@
 #define DELETE_CHUNK_RADIUS 14
 #define CHUNK_SIZE 32
 #define COMMIT_INTERVAL 5
+#define RECV_BYTE_BUDGET 262144
+#define RECV_TIME_BUDGET 0.004
+#define DENSE_STORAGE 1
+#define GREEDY_MESHING 1
+#define PACKED_VERTICES 1
+#define INDEXED_QUADS 1
+#define SIMD_OCCLUSION 1
+#define MESH_CACHE 1
+#define BLOB_STORAGE 1
+#define CHUNK_ARENA 1
+#define CAVE_CULLING 1
+#define LOD_LEVELS 3
 
 #endif
@@ -1,55 +1,59 @@
 #include <math.h>
+#include <string.h>
 #include "cube.h"
 #include "item.h"
 #include "matrix.h"
 #include "util.h"
 
+static const float cube_positions[6][4][3] = {
+    {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
+    {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
+    {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
+    {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
+    {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}
+};
+static const float cube_normals[6][3] = {
+    {-1, 0, 0},
+    {+1, 0, 0},
+    {0, +1, 0},
+    {0, -1, 0},
+    {0, 0, -1},
+    {0, 0, +1}
+};
+static const float cube_uvs[6][4][2] = {
+    {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
+    {{1, 0}, {0, 0}, {1, 1}, {0, 1}},
+    {{0, 1}, {0, 0}, {1, 1}, {1, 0}},
+    {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
+    {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
+    {{1, 0}, {1, 1}, {0, 0}, {0, 1}}
+};
+static const int cube_indices[6][6] = {
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3},
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3},
+    {0, 3, 2, 0, 1, 3},
+    {0, 3, 1, 0, 2, 3}
+};
+static const int cube_flipped[6][6] = {
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1},
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1},
+    {0, 1, 2, 1, 3, 2},
+    {0, 2, 1, 2, 3, 1}
+};
+static const int cube_u_axes[6] = {2, 2, 0, 0, 0, 0};
+static const int cube_v_axes[6] = {1, 1, 2, 2, 1, 1};
+
 void make_cube_faces(
     float *data, float ao[6][4], float light[6][4],
     int left, int right, int top, int bottom, int front, int back,
     int wleft, int wright, int wtop, int wbottom, int wfront, int wback,
     float x, float y, float z, float n)
 {
-    static const float positions[6][4][3] = {
-        {{-1, -1, -1}, {-1, -1, +1}, {-1, +1, -1}, {-1, +1, +1}},
-        {{+1, -1, -1}, {+1, -1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-        {{-1, +1, -1}, {-1, +1, +1}, {+1, +1, -1}, {+1, +1, +1}},
-        {{-1, -1, -1}, {-1, -1, +1}, {+1, -1, -1}, {+1, -1, +1}},
-        {{-1, -1, -1}, {-1, +1, -1}, {+1, -1, -1}, {+1, +1, -1}},
-        {{-1, -1, +1}, {-1, +1, +1}, {+1, -1, +1}, {+1, +1, +1}}
-    };
-    static const float normals[6][3] = {
-        {-1, 0, 0},
-        {+1, 0, 0},
-        {0, +1, 0},
-        {0, -1, 0},
-        {0, 0, -1},
-        {0, 0, +1}
-    };
-    static const float uvs[6][4][2] = {
-        {{0, 0}, {1, 0}, {0, 1}, {1, 1}},
-        {{1, 0}, {0, 0}, {1, 1}, {0, 1}},
-        {{0, 1}, {0, 0}, {1, 1}, {1, 0}},
-        {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
-        {{0, 0}, {0, 1}, {1, 0}, {1, 1}},
-        {{1, 0}, {1, 1}, {0, 0}, {0, 1}}
-    };
-    static const float indices[6][6] = {
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3},
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3},
-        {0, 3, 2, 0, 1, 3},
-        {0, 3, 1, 0, 2, 3}
-    };
-    static const float flipped[6][6] = {
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1},
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1},
-        {0, 1, 2, 1, 3, 2},
-        {0, 2, 1, 2, 3, 1}
-    };
     float *d = data;
     float s = 0.0625;
     float a = 0 + 1 / 2048.0;
@@ -64,15 +68,15 @@ void make_cube_faces(
         float dv = (tiles[i] / 16) * s;
         int flip = ao[i][0] + ao[i][3] > ao[i][1] + ao[i][2];
         for (int v = 0; v < 6; v++) {
-            int j = flip ? flipped[i][v] : indices[i][v];
-            *(d++) = x + n * positions[i][j][0];
-            *(d++) = y + n * positions[i][j][1];
-            *(d++) = z + n * positions[i][j][2];
-            *(d++) = normals[i][0];
-            *(d++) = normals[i][1];
-            *(d++) = normals[i][2];
-            *(d++) = du + (uvs[i][j][0] ? b : a);
-            *(d++) = dv + (uvs[i][j][1] ? b : a);
+            int j = flip ? cube_flipped[i][v] : cube_indices[i][v];
+            *(d++) = x + n * cube_positions[i][j][0];
+            *(d++) = y + n * cube_positions[i][j][1];
+            *(d++) = z + n * cube_positions[i][j][2];
+            *(d++) = cube_normals[i][0];
+            *(d++) = cube_normals[i][1];
+            *(d++) = cube_normals[i][2];
+            *(d++) = du + (cube_uvs[i][j][0] ? b : a);
+            *(d++) = dv + (cube_uvs[i][j][1] ? b : a);
             *(d++) = ao[i][j];
             *(d++) = light[i][j];
         }
@@ -97,6 +101,74 @@ void make_cube(
         x, y, z, n);
 }
 
+void make_cube_quad(
+    float *data, float ao[4], float light[4], int face, int w,
+    float x1, float y1, float z1, float x2, float y2, float z2, float n)
+{
+    // spans the blocks from (x1, y1, z1) to (x2, y2, z2); uvs are
+    // (tile + 1) * 64 plus a block offset so the shader can repeat the tile
+    float lo[3] = {x1 - n, y1 - n, z1 - n};
+    float hi[3] = {x2 + n, y2 + n, z2 + n};
+    float size[3] = {x2 - x1 + 1, y2 - y1 + 1, z2 - z1 + 1};
+    float su = size[cube_u_axes[face]];
+    float sv = size[cube_v_axes[face]];
+    float du = (w % 16 + 1) * 64;
+    float dv = (w / 16 + 1) * 64;
+    float *d = data;
+    int flip = ao[0] + ao[3] > ao[1] + ao[2];
+    for (int v = 0; v < 6; v++) {
+        int j = flip ? cube_flipped[face][v] : cube_indices[face][v];
+        for (int k = 0; k < 3; k++) {
+            *(d++) = cube_positions[face][j][k] < 0 ? lo[k] : hi[k];
+        }
+        *(d++) = cube_normals[face][0];
+        *(d++) = cube_normals[face][1];
+        *(d++) = cube_normals[face][2];
+        *(d++) = du + cube_uvs[face][j][0] * su;
+        *(d++) = dv + cube_uvs[face][j][1] * sv;
+        *(d++) = ao[j];
+        *(d++) = light[j];
+    }
+}
+
+void make_quads(float *data, int faces) {
+    // rewrites faces of two triangles as four vertices ordered so that
+    // the indices 0, 1, 2, 0, 2, 3 give back the same two triangles
+    for (int i = 0; i < faces; i++) {
+        float quad[4][10];
+        float *src = data + i * 60;
+        int a = 0;
+        int b = 3;
+        for (int j = 0; j < 3; j++) {
+            int shared = 0;
+            for (int k = 3; k < 6; k++) {
+                if (!memcmp(src + j * 10, src + k * 10, sizeof(float) * 3)) {
+                    shared = 1;
+                }
+            }
+            if (!shared) {
+                a = j;
+            }
+        }
+        for (int k = 3; k < 6; k++) {
+            int shared = 0;
+            for (int j = 0; j < 3; j++) {
+                if (!memcmp(src + j * 10, src + k * 10, sizeof(float) * 3)) {
+                    shared = 1;
+                }
+            }
+            if (!shared) {
+                b = k;
+            }
+        }
+        memcpy(quad[0], src + (a + 2) % 3 * 10, sizeof(float) * 10);
+        memcpy(quad[1], src + a * 10, sizeof(float) * 10);
+        memcpy(quad[2], src + (a + 1) % 3 * 10, sizeof(float) * 10);
+        memcpy(quad[3], src + b * 10, sizeof(float) * 10);
+        memcpy(data + i * 40, quad, sizeof(quad));
+    }
+}
+
 void make_plant(
     float *data, float ao, float light,
     float px, float py, float pz, float n, int w, float rotation)
@@ -12,6 +12,12 @@ void make_cube(
     int left, int right, int top, int bottom, int front, int back,
     float x, float y, float z, float n, int w);
 
+void make_cube_quad(
+    float *data, float ao[4], float light[4], int face, int w,
+    float x1, float y1, float z1, float x2, float y2, float z2, float n);
+
+void make_quads(float *data, int faces);
+
 void make_plant(
     float *data, float ao, float light,
     float px, float py, float pz, float n, int w, float rotation);
@@ -1,28 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "blob.h"
+#include "config.h"
 #include "db.h"
 #include "ring.h"
 #include "sqlite3.h"
+#include "table.h"
 #include "tinycthread.h"
 
+// rows per multi-row insert, 6 variables each, under sqlite's 999 limit
+#define DB_BATCH 64
+// entries the writer takes off the ring per lock
+#define DB_DRAIN 1024
+// queued entries at which db_insert_block / db_insert_light block the
+// caller, and the level the writer must get back under to release them
+#define DB_HIGH_WATER 65536
+#define DB_LOW_WATER 16384
+// distinct edits kept between commits before they are written early
+#define DB_WRITES_MAX 262144
+
 static int db_enabled = 0;
 
 static sqlite3 *db;
 static sqlite3_stmt *insert_block_stmt;
 static sqlite3_stmt *insert_light_stmt;
+static sqlite3_stmt *insert_blocks_stmt;
+static sqlite3_stmt *insert_lights_stmt;
 static sqlite3_stmt *insert_sign_stmt;
 static sqlite3_stmt *delete_sign_stmt;
 static sqlite3_stmt *delete_signs_stmt;
-static sqlite3_stmt *load_blocks_stmt;
-static sqlite3_stmt *load_lights_stmt;
 static sqlite3_stmt *load_signs_stmt;
 static sqlite3_stmt *get_key_stmt;
 static sqlite3_stmt *set_key_stmt;
+static sqlite3_stmt *load_chunk_stmt;
+static sqlite3_stmt *save_chunk_stmt;
 
 static Ring ring;
 static thrd_t thrd;
 static mtx_t mtx;
 static cnd_t cnd;
-static mtx_t load_mtx;
+static cnd_t drained;
+
+// block and light edits seen by the writer since the last commit, keyed
+// by position so only the last value of each is written
+typedef struct {
+    int used;
+    int light;
+    int p;
+    int q;
+    int x;
+    int y;
+    int z;
+    int w;
+} Write;
+
+static Write *writes;
+static unsigned int write_mask;
+static unsigned int write_count;
+
+// commits asked for by the main thread and the ones the writer has begun
+// and finished, so that a read through another connection can tell which
+// of the edits made so far it saw; edit_commit is the commit that will
+// carry the latest edit
+static int commit_requested;
+static int commit_started;
+static int commit_finished;
+static int edit_commit;
+
+// read only connections, one per loading thread, so chunk loads never
+// wait on each other or on the writer
+typedef struct {
+    sqlite3 *db;
+    sqlite3_stmt *load_blocks_stmt;
+    sqlite3_stmt *load_lights_stmt;
+    sqlite3_stmt *area_blocks_stmt;
+    sqlite3_stmt *area_lights_stmt;
+    sqlite3_stmt *load_chunk_stmt;
+    sqlite3_stmt *area_chunk_stmt;
+    EditList edits;
+} Reader;
+
+static Reader *readers;
+static int reader_count;
+
+// with BLOB_STORAGE, edits wait here until the next commit rewrites the
+// blobs of the chunks they belong to
+typedef struct {
+    EditList blocks;
+    EditList lights;
+} Pending;
+
+static Table pending;
+
+static const char *rows_query =
+    "create table if not exists block ("
+    "    p int not null,"
+    "    q int not null,"
+    "    x int not null,"
+    "    y int not null,"
+    "    z int not null,"
+    "    w int not null"
+    ");"
+    "create table if not exists light ("
+    "    p int not null,"
+    "    q int not null,"
+    "    x int not null,"
+    "    y int not null,"
+    "    z int not null,"
+    "    w int not null"
+    ");"
+    "create unique index if not exists block_pqxyz_idx on block (p, q, x, y, z);"
+    "create unique index if not exists light_pqxyz_idx on light (p, q, x, y, z);";
+
+static const char *chunks_query =
+    "create table if not exists chunk ("
+    "    p int not null,"
+    "    q int not null,"
+    "    version int not null,"
+    "    blocks blob,"
+    "    lights blob"
+    ");"
+    "create unique index if not exists chunk_pq_idx on chunk (p, q);";
 
 void db_enable() {
     db_enabled = 1;
@@ -36,7 +135,197 @@ int get_db_enabled() {
     return db_enabled;
 }
 
-int db_init(char *path) {
+static int db_reader_open(Reader *reader, char *path) {
+    static const char *load_blocks_query =
+        "select p, q, x, y, z, w from block where p = ? and q = ?;";
+    static const char *load_lights_query =
+        "select p, q, x, y, z, w from light where p = ? and q = ?;";
+    static const char *area_blocks_query =
+        "select p, q, x, y, z, w from block "
+        "where p in (?, ?, ?) and q in (?, ?, ?);";
+    static const char *area_lights_query =
+        "select p, q, x, y, z, w from light "
+        "where p in (?, ?, ?) and q in (?, ?, ?);";
+    static const char *load_chunk_query =
+        "select p, q, blocks, lights from chunk where p = ? and q = ?;";
+    static const char *area_chunk_query =
+        "select p, q, blocks, lights from chunk "
+        "where p in (?, ?, ?) and q in (?, ?, ?);";
+    int rc;
+    rc = sqlite3_open_v2(path, &reader->db,
+        SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL);
+    if (rc) return rc;
+    if (BLOB_STORAGE) {
+        edit_list_alloc(&reader->edits, 1024);
+        rc = sqlite3_prepare_v2(reader->db, load_chunk_query, -1,
+            &reader->load_chunk_stmt, NULL);
+        if (rc) return rc;
+        rc = sqlite3_prepare_v2(reader->db, area_chunk_query, -1,
+            &reader->area_chunk_stmt, NULL);
+        return rc;
+    }
+    rc = sqlite3_prepare_v2(reader->db, load_blocks_query, -1,
+        &reader->load_blocks_stmt, NULL);
+    if (rc) return rc;
+    rc = sqlite3_prepare_v2(reader->db, load_lights_query, -1,
+        &reader->load_lights_stmt, NULL);
+    if (rc) return rc;
+    rc = sqlite3_prepare_v2(reader->db, area_blocks_query, -1,
+        &reader->area_blocks_stmt, NULL);
+    if (rc) return rc;
+    rc = sqlite3_prepare_v2(reader->db, area_lights_query, -1,
+        &reader->area_lights_stmt, NULL);
+    if (rc) return rc;
+    return 0;
+}
+
+static void db_reader_close(Reader *reader) {
+    sqlite3_finalize(reader->load_blocks_stmt);
+    sqlite3_finalize(reader->load_lights_stmt);
+    sqlite3_finalize(reader->area_blocks_stmt);
+    sqlite3_finalize(reader->area_lights_stmt);
+    sqlite3_finalize(reader->load_chunk_stmt);
+    sqlite3_finalize(reader->area_chunk_stmt);
+    sqlite3_close(reader->db);
+    if (BLOB_STORAGE) {
+        edit_list_free(&reader->edits);
+    }
+}
+
+static Pending *db_pending(int p, int q) {
+    Pending *chunk = (Pending *)table_get(&pending, p, q);
+    if (!chunk) {
+        chunk = (Pending *)malloc(sizeof(Pending));
+        edit_list_alloc(&chunk->blocks, 16);
+        edit_list_alloc(&chunk->lights, 4);
+        table_set(&pending, p, q, chunk);
+    }
+    return chunk;
+}
+
+static void db_flush() {
+    // rewrites the blobs of every chunk edited since the last flush
+    EditList list;
+    edit_list_alloc(&list, 1024);
+    for (unsigned int i = 0; i <= pending.mask; i++) {
+        TableEntry *entry = pending.data + i;
+        if (EMPTY_SLOT(entry)) {
+            continue;
+        }
+        int p = entry->p;
+        int q = entry->q;
+        Pending *chunk = (Pending *)entry->value;
+        sqlite3_reset(load_chunk_stmt);
+        sqlite3_bind_int(load_chunk_stmt, 1, p);
+        sqlite3_bind_int(load_chunk_stmt, 2, q);
+        int found = sqlite3_step(load_chunk_stmt) == SQLITE_ROW;
+        unsigned char *blobs[2] = {0, 0};
+        size_t sizes[2] = {0, 0};
+        for (int light = 0; light < 2; light++) {
+            EditList *edits = light ? &chunk->lights : &chunk->blocks;
+            list.size = 0;
+            if (found) {
+                const unsigned char *data = (const unsigned char *)
+                    sqlite3_column_blob(load_chunk_stmt, light);
+                int size = sqlite3_column_bytes(load_chunk_stmt, light);
+                if (data) {
+                    blob_decode(&list, p, q, data, size);
+                }
+            }
+            for (unsigned int j = 0; j < edits->size; j++) {
+                Edit *e = edits->data + j;
+                edit_list_add(&list, e->x, e->y, e->z, e->w);
+            }
+            edit_list_merge(&list);
+            if (list.size) {
+                blob_encode(&list, p, q, blobs + light, sizes + light);
+            }
+            edit_list_free(edits);
+        }
+        sqlite3_reset(load_chunk_stmt);
+        sqlite3_reset(save_chunk_stmt);
+        sqlite3_bind_int(save_chunk_stmt, 1, p);
+        sqlite3_bind_int(save_chunk_stmt, 2, q);
+        sqlite3_bind_int(save_chunk_stmt, 3, BLOB_VERSION);
+        for (int light = 0; light < 2; light++) {
+            if (blobs[light]) {
+                sqlite3_bind_blob(save_chunk_stmt, 4 + light,
+                    blobs[light], sizes[light], SQLITE_STATIC);
+            }
+            else {
+                sqlite3_bind_null(save_chunk_stmt, 4 + light);
+            }
+        }
+        sqlite3_step(save_chunk_stmt);
+        free(blobs[0]);
+        free(blobs[1]);
+        free(chunk);
+    }
+    table_clear(&pending);
+    edit_list_free(&list);
+}
+
+static int db_migrate() {
+    // moves the rows of a database saved one row per edit into blobs
+    static const char *tables[2] = {"block", "light"};
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db,
+        "select count(*) from sqlite_master "
+        "where type = 'table' and name = 'block';", -1, &stmt, NULL);
+    if (rc) return rc;
+    int found = sqlite3_step(stmt) == SQLITE_ROW &&
+        sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (!found) {
+        return 0;
+    }
+    sqlite3_exec(db, "begin;", NULL, NULL, NULL);
+    for (int light = 0; light < 2; light++) {
+        char query[128];
+        snprintf(query, sizeof(query),
+            "select p, q, x, y, z, w from %s order by p, q;", tables[light]);
+        if (sqlite3_prepare_v2(db, query, -1, &stmt, NULL)) {
+            continue;
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int p = sqlite3_column_int(stmt, 0);
+            int q = sqlite3_column_int(stmt, 1);
+            int x = sqlite3_column_int(stmt, 2);
+            int y = sqlite3_column_int(stmt, 3);
+            int z = sqlite3_column_int(stmt, 4);
+            int w = sqlite3_column_int(stmt, 5);
+            Pending *chunk = db_pending(p, q);
+            edit_list_add(light ? &chunk->lights : &chunk->blocks,
+                x, y, z, w);
+            // flushing merges with what is already saved, so a chunk
+            // split across two flushes still ends up whole
+            if (pending.size >= 256) {
+                db_flush();
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    db_flush();
+    sqlite3_exec(db,
+        "drop table if exists block; drop table if exists light; commit;",
+        NULL, NULL, NULL);
+    sqlite3_exec(db, "vacuum;", NULL, NULL, NULL);
+    return 0;
+}
+
+static int db_prepare_batch(const char *table, sqlite3_stmt **stmt) {
+    static const char *row = "(?, ?, ?, ?, ?, ?)";
+    char query[64 + DB_BATCH * 20];
+    int length = snprintf(query, sizeof(query),
+        "insert or replace into %s (p, q, x, y, z, w) values ", table);
+    for (int i = 0; i < DB_BATCH; i++) {
+        length += snprintf(query + length, sizeof(query) - length,
+            "%s%s", row, i + 1 < DB_BATCH ? ", " : ";");
+    }
+    return sqlite3_prepare_v2(db, query, -1, stmt, NULL);
+}
+
+int db_init(char *path, int count) {
     if (!db_enabled) {
         return 0;
     }
@@ -56,22 +345,6 @@ int db_init(char *path) {
         "   rx float not null,"
         "   ry float not null"
         ");"
-        "create table if not exists block ("
-        "    p int not null,"
-        "    q int not null,"
-        "    x int not null,"
-        "    y int not null,"
-        "    z int not null,"
-        "    w int not null"
-        ");"
-        "create table if not exists light ("
-        "    p int not null,"
-        "    q int not null,"
-        "    x int not null,"
-        "    y int not null,"
-        "    z int not null,"
-        "    w int not null"
-        ");"
         "create table if not exists key ("
         "    p int not null,"
         "    q int not null,"
@@ -86,8 +359,6 @@ int db_init(char *path) {
         "    face int not null,"
         "    text text not null"
         ");"
-        "create unique index if not exists block_pqxyz_idx on block (p, q, x, y, z);"
-        "create unique index if not exists light_pqxyz_idx on light (p, q, x, y, z);"
         "create unique index if not exists key_pq_idx on key (p, q);"
         "create unique index if not exists sign_xyzface_idx on sign (x, y, z, face);"
         "create index if not exists sign_pq_idx on sign (p, q);";
@@ -104,10 +375,6 @@ int db_init(char *path) {
         "delete from sign where x = ? and y = ? and z = ? and face = ?;";
     static const char *delete_signs_query =
         "delete from sign where x = ? and y = ? and z = ?;";
-    static const char *load_blocks_query =
-        "select x, y, z, w from block where p = ? and q = ?;";
-    static const char *load_lights_query =
-        "select x, y, z, w from light where p = ? and q = ?;";
     static const char *load_signs_query =
         "select x, y, z, face, text from sign where p = ? and q = ?;";
     static const char *get_key_query =
@@ -115,17 +382,48 @@ int db_init(char *path) {
     static const char *set_key_query =
         "insert or replace into key (p, q, key) "
         "values (?, ?, ?);";
+    static const char *load_chunk_query =
+        "select blocks, lights from chunk where p = ? and q = ?;";
+    static const char *save_chunk_query =
+        "insert or replace into chunk (p, q, version, blocks, lights) "
+        "values (?, ?, ?, ?, ?);";
     int rc;
     rc = sqlite3_open(path, &db);
     if (rc) return rc;
-    rc = sqlite3_exec(db, create_query, NULL, NULL, NULL);
+    // write ahead logging lets the readers run while the writer holds
+    // its transaction open between commits
+    rc = sqlite3_exec(db,
+        "pragma journal_mode = wal; pragma synchronous = normal;",
+        NULL, NULL, NULL);
     if (rc) return rc;
-    rc = sqlite3_prepare_v2(
-        db, insert_block_query, -1, &insert_block_stmt, NULL);
+    rc = sqlite3_exec(db, create_query, NULL, NULL, NULL);
     if (rc) return rc;
-    rc = sqlite3_prepare_v2(
-        db, insert_light_query, -1, &insert_light_stmt, NULL);
+    rc = sqlite3_exec(
+        db, BLOB_STORAGE ? chunks_query : rows_query, NULL, NULL, NULL);
     if (rc) return rc;
+    if (BLOB_STORAGE) {
+        rc = sqlite3_prepare_v2(
+            db, load_chunk_query, -1, &load_chunk_stmt, NULL);
+        if (rc) return rc;
+        rc = sqlite3_prepare_v2(
+            db, save_chunk_query, -1, &save_chunk_stmt, NULL);
+        if (rc) return rc;
+        table_alloc(&pending, 255);
+        rc = db_migrate();
+        if (rc) return rc;
+    }
+    else {
+        rc = sqlite3_prepare_v2(
+            db, insert_block_query, -1, &insert_block_stmt, NULL);
+        if (rc) return rc;
+        rc = sqlite3_prepare_v2(
+            db, insert_light_query, -1, &insert_light_stmt, NULL);
+        if (rc) return rc;
+        rc = db_prepare_batch("block", &insert_blocks_stmt);
+        if (rc) return rc;
+        rc = db_prepare_batch("light", &insert_lights_stmt);
+        if (rc) return rc;
+    }
     rc = sqlite3_prepare_v2(
         db, insert_sign_query, -1, &insert_sign_stmt, NULL);
     if (rc) return rc;
@@ -135,16 +433,18 @@ int db_init(char *path) {
     rc = sqlite3_prepare_v2(
         db, delete_signs_query, -1, &delete_signs_stmt, NULL);
     if (rc) return rc;
-    rc = sqlite3_prepare_v2(db, load_blocks_query, -1, &load_blocks_stmt, NULL);
-    if (rc) return rc;
-    rc = sqlite3_prepare_v2(db, load_lights_query, -1, &load_lights_stmt, NULL);
-    if (rc) return rc;
     rc = sqlite3_prepare_v2(db, load_signs_query, -1, &load_signs_stmt, NULL);
     if (rc) return rc;
     rc = sqlite3_prepare_v2(db, get_key_query, -1, &get_key_stmt, NULL);
     if (rc) return rc;
     rc = sqlite3_prepare_v2(db, set_key_query, -1, &set_key_stmt, NULL);
     if (rc) return rc;
+    readers = (Reader *)calloc(count, sizeof(Reader));
+    reader_count = count;
+    for (int i = 0; i < count; i++) {
+        rc = db_reader_open(readers + i, path);
+        if (rc) return rc;
+    }
     sqlite3_exec(db, "begin;", NULL, NULL, NULL);
     db_worker_start();
     return 0;
@@ -155,17 +455,29 @@ void db_close() {
         return;
     }
     db_worker_stop();
+    if (BLOB_STORAGE) {
+        db_flush();
+        table_free(&pending);
+    }
     sqlite3_exec(db, "commit;", NULL, NULL, NULL);
+    sqlite3_finalize(load_chunk_stmt);
+    sqlite3_finalize(save_chunk_stmt);
     sqlite3_finalize(insert_block_stmt);
     sqlite3_finalize(insert_light_stmt);
+    sqlite3_finalize(insert_blocks_stmt);
+    sqlite3_finalize(insert_lights_stmt);
     sqlite3_finalize(insert_sign_stmt);
     sqlite3_finalize(delete_sign_stmt);
     sqlite3_finalize(delete_signs_stmt);
-    sqlite3_finalize(load_blocks_stmt);
-    sqlite3_finalize(load_lights_stmt);
     sqlite3_finalize(load_signs_stmt);
     sqlite3_finalize(get_key_stmt);
     sqlite3_finalize(set_key_stmt);
+    for (int i = 0; i < reader_count; i++) {
+        db_reader_close(readers + i);
+    }
+    free(readers);
+    readers = 0;
+    reader_count = 0;
     sqlite3_close(db);
 }
 
@@ -175,11 +487,29 @@ void db_commit() {
     }
     mtx_lock(&mtx);
     ring_put_commit(&ring);
+    commit_requested++;
     cnd_signal(&cnd);
     mtx_unlock(&mtx);
 }
 
+int db_snapshot() {
+    // main thread only: the number of commits after which every edit made
+    // so far is visible, or -1 while some are not part of one yet
+    return edit_commit > commit_requested ? -1 : commit_requested;
+}
+
+int db_committed(int commit) {
+    // exactly the given number of commits is visible, with none under way
+    mtx_lock(&mtx);
+    int result = commit_started == commit && commit_finished == commit;
+    mtx_unlock(&mtx);
+    return result;
+}
+
 void _db_commit() {
+    if (BLOB_STORAGE) {
+        db_flush();
+    }
     sqlite3_exec(db, "commit; begin;", NULL, NULL, NULL);
 }
 
@@ -317,12 +647,38 @@ void db_insert_block(int p, int q, int x, int y, int z, int w) {
         return;
     }
     mtx_lock(&mtx);
+    while (ring_size(&ring) >= DB_HIGH_WATER) {
+        cnd_wait(&drained, &mtx);
+    }
     ring_put_block(&ring, p, q, x, y, z, w);
+    edit_commit = commit_requested + 1;
+    cnd_signal(&cnd);
+    mtx_unlock(&mtx);
+}
+
+void db_insert_edits(int p, int q, EditList *list) {
+    // every block of a batch goes on the ring under one lock
+    if (!db_enabled || !list->size) {
+        return;
+    }
+    mtx_lock(&mtx);
+    while (ring_size(&ring) >= DB_HIGH_WATER) {
+        cnd_wait(&drained, &mtx);
+    }
+    for (unsigned int i = 0; i < list->size; i++) {
+        Edit *e = list->data + i;
+        ring_put_block(&ring, p, q, e->x, e->y, e->z, e->w);
+    }
+    edit_commit = commit_requested + 1;
     cnd_signal(&cnd);
     mtx_unlock(&mtx);
 }
 
 void _db_insert_block(int p, int q, int x, int y, int z, int w) {
+    if (BLOB_STORAGE) {
+        edit_list_add(&db_pending(p, q)->blocks, x, y, z, w);
+        return;
+    }
     sqlite3_reset(insert_block_stmt);
     sqlite3_bind_int(insert_block_stmt, 1, p);
     sqlite3_bind_int(insert_block_stmt, 2, q);
@@ -338,12 +694,20 @@ void db_insert_light(int p, int q, int x, int y, int z, int w) {
         return;
     }
     mtx_lock(&mtx);
+    while (ring_size(&ring) >= DB_HIGH_WATER) {
+        cnd_wait(&drained, &mtx);
+    }
     ring_put_light(&ring, p, q, x, y, z, w);
+    edit_commit = commit_requested + 1;
     cnd_signal(&cnd);
     mtx_unlock(&mtx);
 }
 
 void _db_insert_light(int p, int q, int x, int y, int z, int w) {
+    if (BLOB_STORAGE) {
+        edit_list_add(&db_pending(p, q)->lights, x, y, z, w);
+        return;
+    }
     sqlite3_reset(insert_light_stmt);
     sqlite3_bind_int(insert_light_stmt, 1, p);
     sqlite3_bind_int(insert_light_stmt, 2, q);
@@ -401,40 +765,111 @@ void db_delete_all_signs() {
     sqlite3_exec(db, "delete from sign;", NULL, NULL, NULL);
 }
 
-void db_load_blocks(Map *map, int p, int q) {
-    if (!db_enabled) {
-        return;
-    }
-    mtx_lock(&load_mtx);
-    sqlite3_reset(load_blocks_stmt);
-    sqlite3_bind_int(load_blocks_stmt, 1, p);
-    sqlite3_bind_int(load_blocks_stmt, 2, q);
-    while (sqlite3_step(load_blocks_stmt) == SQLITE_ROW) {
-        int x = sqlite3_column_int(load_blocks_stmt, 0);
-        int y = sqlite3_column_int(load_blocks_stmt, 1);
-        int z = sqlite3_column_int(load_blocks_stmt, 2);
-        int w = sqlite3_column_int(load_blocks_stmt, 3);
+static unsigned long long db_mix(unsigned long long h) {
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+static void db_load_edit(
+    int p, int q, Map *map, unsigned long long hashes[3][3], int light,
+    int a, int b, int x, int y, int z, int w)
+{
+    if (map && a == p && b == q) {
         map_set(map, x, y, z, w);
     }
-    mtx_unlock(&load_mtx);
+    if (hashes) {
+        unsigned long long h = db_mix(
+            ((unsigned long long)(unsigned int)a << 32) | (unsigned int)b);
+        h = light ? ~h : h;
+        int values[4] = {x, y, z, w};
+        for (int i = 0; i < 4; i++) {
+            h = db_mix(h + (unsigned int)values[i]);
+        }
+        // summed so the hash does not depend on row order or format
+        hashes[a - p + 1][b - q + 1] += h;
+    }
 }
 
-void db_load_lights(Map *map, int p, int q) {
-    if (!db_enabled) {
+static void db_bind_area(sqlite3_stmt *stmt, int area, int p, int q) {
+    sqlite3_reset(stmt);
+    if (area) {
+        for (int i = 0; i < 3; i++) {
+            sqlite3_bind_int(stmt, i + 1, p + i - 1);
+            sqlite3_bind_int(stmt, i + 4, q + i - 1);
+        }
+    }
+    else {
+        sqlite3_bind_int(stmt, 1, p);
+        sqlite3_bind_int(stmt, 2, q);
+    }
+}
+
+static void db_load_rows(
+    sqlite3_stmt *stmt, int area, int light, int p, int q,
+    Map *map, unsigned long long hashes[3][3])
+{
+    db_bind_area(stmt, area, p, q);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        db_load_edit(
+            p, q, map, hashes, light,
+            sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1),
+            sqlite3_column_int(stmt, 2), sqlite3_column_int(stmt, 3),
+            sqlite3_column_int(stmt, 4), sqlite3_column_int(stmt, 5));
+    }
+}
+
+static void db_load_blobs(
+    Reader *reader, sqlite3_stmt *stmt, int area, int p, int q,
+    Map *block_map, Map *light_map, unsigned long long hashes[3][3])
+{
+    db_bind_area(stmt, area, p, q);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int a = sqlite3_column_int(stmt, 0);
+        int b = sqlite3_column_int(stmt, 1);
+        for (int light = 0; light < 2; light++) {
+            const unsigned char *data = (const unsigned char *)
+                sqlite3_column_blob(stmt, 2 + light);
+            int size = sqlite3_column_bytes(stmt, 2 + light);
+            EditList *edits = &reader->edits;
+            edits->size = 0;
+            if (!data || !blob_decode(edits, a, b, data, size)) {
+                continue;
+            }
+            Map *map = light ? light_map : block_map;
+            for (unsigned int i = 0; i < edits->size; i++) {
+                Edit *e = edits->data + i;
+                db_load_edit(
+                    p, q, map, hashes, light,
+                    a, b, e->x, e->y, e->z, e->w);
+            }
+        }
+    }
+}
+
+void db_load_area(
+    int reader, int p, int q, Map *block_map, Map *light_map,
+    unsigned long long hashes[3][3])
+{
+    if (hashes) {
+        memset(hashes, 0, sizeof(unsigned long long) * 9);
+    }
+    if (!db_enabled || reader >= reader_count) {
         return;
     }
-    mtx_lock(&load_mtx);
-    sqlite3_reset(load_lights_stmt);
-    sqlite3_bind_int(load_lights_stmt, 1, p);
-    sqlite3_bind_int(load_lights_stmt, 2, q);
-    while (sqlite3_step(load_lights_stmt) == SQLITE_ROW) {
-        int x = sqlite3_column_int(load_lights_stmt, 0);
-        int y = sqlite3_column_int(load_lights_stmt, 1);
-        int z = sqlite3_column_int(load_lights_stmt, 2);
-        int w = sqlite3_column_int(load_lights_stmt, 3);
-        map_set(map, x, y, z, w);
+    Reader *r = readers + reader;
+    if (BLOB_STORAGE) {
+        sqlite3_stmt *stmt = hashes ? r->area_chunk_stmt : r->load_chunk_stmt;
+        db_load_blobs(r, stmt, hashes != 0, p, q, block_map, light_map, hashes);
+    }
+    else if (hashes) {
+        db_load_rows(r->area_blocks_stmt, 1, 0, p, q, block_map, hashes);
+        db_load_rows(r->area_lights_stmt, 1, 1, p, q, light_map, hashes);
+    }
+    else {
+        db_load_rows(r->load_blocks_stmt, 0, 0, p, q, block_map, 0);
+        db_load_rows(r->load_lights_stmt, 0, 1, p, q, light_map, 0);
     }
-    mtx_unlock(&load_mtx);
 }
 
 void db_load_signs(SignList *list, int p, int q) {
@@ -486,14 +921,129 @@ void _db_set_key(int p, int q, int key) {
     sqlite3_step(set_key_stmt);
 }
 
+static unsigned int db_write_hash(Write *write) {
+    int values[6] = {
+        write->light, write->p, write->q, write->x, write->y, write->z};
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ (unsigned int)values[i]) * 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+static void db_write_put(Write *table, unsigned int mask, Write *write) {
+    unsigned int index = db_write_hash(write) & mask;
+    Write *entry = table + index;
+    while (entry->used) {
+        if (entry->light == write->light &&
+            entry->p == write->p && entry->q == write->q &&
+            entry->x == write->x && entry->y == write->y &&
+            entry->z == write->z)
+        {
+            entry->w = write->w;
+            return;
+        }
+        index = (index + 1) & mask;
+        entry = table + index;
+    }
+    *entry = *write;
+    entry->used = 1;
+    write_count++;
+}
+
+static void db_write_grow() {
+    unsigned int mask = (write_mask << 1) | 1;
+    Write *table = (Write *)calloc(mask + 1, sizeof(Write));
+    write_count = 0;
+    for (unsigned int i = 0; i <= write_mask; i++) {
+        if (writes[i].used) {
+            db_write_put(table, mask, writes + i);
+        }
+    }
+    free(writes);
+    writes = table;
+    write_mask = mask;
+}
+
+static void db_write_add(int light, int p, int q, int x, int y, int z, int w) {
+    Write write = {1, light, p, q, x, y, z, w};
+    db_write_put(writes, write_mask, &write);
+    if (write_count * 2 > write_mask) {
+        db_write_grow();
+    }
+}
+
+static void db_write_batch(int light, Write **batch, int count) {
+    if (count < DB_BATCH) {
+        for (int i = 0; i < count; i++) {
+            Write *e = batch[i];
+            if (light) {
+                _db_insert_light(e->p, e->q, e->x, e->y, e->z, e->w);
+            }
+            else {
+                _db_insert_block(e->p, e->q, e->x, e->y, e->z, e->w);
+            }
+        }
+        return;
+    }
+    sqlite3_stmt *stmt = light ? insert_lights_stmt : insert_blocks_stmt;
+    sqlite3_reset(stmt);
+    for (int i = 0; i < count; i++) {
+        Write *e = batch[i];
+        int values[6] = {e->p, e->q, e->x, e->y, e->z, e->w};
+        for (int j = 0; j < 6; j++) {
+            sqlite3_bind_int(stmt, i * 6 + j + 1, values[j]);
+        }
+    }
+    sqlite3_step(stmt);
+}
+
+static void db_write_flush() {
+    // positions are unique here, so rows can go out in any order
+    Write *batch[2][DB_BATCH];
+    int count[2] = {0, 0};
+    for (unsigned int i = 0; i <= write_mask; i++) {
+        Write *e = writes + i;
+        if (!e->used) {
+            continue;
+        }
+        if (BLOB_STORAGE) {
+            if (e->light) {
+                _db_insert_light(e->p, e->q, e->x, e->y, e->z, e->w);
+            }
+            else {
+                _db_insert_block(e->p, e->q, e->x, e->y, e->z, e->w);
+            }
+            continue;
+        }
+        batch[e->light][count[e->light]++] = e;
+        if (count[e->light] == DB_BATCH) {
+            db_write_batch(e->light, batch[e->light], DB_BATCH);
+            count[e->light] = 0;
+        }
+    }
+    for (int light = 0; light < 2; light++) {
+        db_write_batch(light, batch[light], count[light]);
+    }
+    memset(writes, 0, (write_mask + 1) * sizeof(Write));
+    write_count = 0;
+}
+
 void db_worker_start(char *path) {
     if (!db_enabled) {
         return;
     }
     ring_alloc(&ring, 1024);
+    write_mask = 0xfff;
+    write_count = 0;
+    writes = (Write *)calloc(write_mask + 1, sizeof(Write));
+    commit_requested = 0;
+    commit_started = 0;
+    commit_finished = 0;
+    edit_commit = 0;
     mtx_init(&mtx, mtx_plain);
-    mtx_init(&load_mtx, mtx_plain);
     cnd_init(&cnd);
+    cnd_init(&drained);
     thrd_create(&thrd, db_worker_run, path);
 }
 
@@ -507,37 +1057,168 @@ void db_worker_stop() {
     mtx_unlock(&mtx);
     thrd_join(thrd, NULL);
     cnd_destroy(&cnd);
-    mtx_destroy(&load_mtx);
+    cnd_destroy(&drained);
     mtx_destroy(&mtx);
     ring_free(&ring);
+    free(writes);
 }
 
 int db_worker_run(void *arg) {
+    RingEntry *entries = (RingEntry *)malloc(sizeof(RingEntry) * DB_DRAIN);
     int running = 1;
     while (running) {
-        RingEntry e;
+        int count = 0;
         mtx_lock(&mtx);
-        while (!ring_get(&ring, &e)) {
+        while (ring_empty(&ring)) {
             cnd_wait(&cnd, &mtx);
         }
+        while (count < DB_DRAIN && ring_get(&ring, entries + count)) {
+            count++;
+        }
+        if (ring_size(&ring) < DB_LOW_WATER) {
+            cnd_broadcast(&drained);
+        }
         mtx_unlock(&mtx);
-        switch (e.type) {
-            case BLOCK:
-                _db_insert_block(e.p, e.q, e.x, e.y, e.z, e.w);
-                break;
-            case LIGHT:
-                _db_insert_light(e.p, e.q, e.x, e.y, e.z, e.w);
-                break;
-            case KEY:
-                _db_set_key(e.p, e.q, e.key);
-                break;
-            case COMMIT:
-                _db_commit();
-                break;
-            case EXIT:
-                running = 0;
-                break;
+        for (int i = 0; i < count && running; i++) {
+            RingEntry *e = entries + i;
+            switch (e->type) {
+                case BLOCK:
+                    db_write_add(0, e->p, e->q, e->x, e->y, e->z, e->w);
+                    break;
+                case LIGHT:
+                    db_write_add(1, e->p, e->q, e->x, e->y, e->z, e->w);
+                    break;
+                case KEY:
+                    _db_set_key(e->p, e->q, e->key);
+                    break;
+                case COMMIT:
+                    db_write_flush();
+                    mtx_lock(&mtx);
+                    commit_started++;
+                    mtx_unlock(&mtx);
+                    _db_commit();
+                    mtx_lock(&mtx);
+                    commit_finished++;
+                    mtx_unlock(&mtx);
+                    break;
+                case EXIT:
+                    db_write_flush();
+                    running = 0;
+                    break;
+            }
+        }
+        if (write_count >= DB_WRITES_MAX) {
+            db_write_flush();
         }
     }
+    free(entries);
     return 0;
 }
+
+static sqlite3 *db_bench_open(const char *path, int blob, int count) {
+    // a builder sized box of edits in chunk (0, 0), saved in one format
+    sqlite3 *bench;
+    remove(path);
+    if (sqlite3_open(path, &bench)) {
+        return 0;
+    }
+    sqlite3_exec(bench, blob ? chunks_query : rows_query, NULL, NULL, NULL);
+    sqlite3_exec(bench, "begin;", NULL, NULL, NULL);
+    EditList list;
+    edit_list_alloc(&list, count);
+    for (int i = 0; i < count; i++) {
+        int x = i % 25;
+        int z = (i / 25) % 25;
+        int y = 16 + i / 625;
+        edit_list_add(&list, x, y, z, 1 + i % 7);
+    }
+    sqlite3_stmt *stmt;
+    if (blob) {
+        unsigned char *data;
+        size_t size;
+        blob_encode(&list, 0, 0, &data, &size);
+        sqlite3_prepare_v2(bench,
+            "insert into chunk (p, q, version, blocks) values (0, 0, ?, ?);",
+            -1, &stmt, NULL);
+        sqlite3_bind_int(stmt, 1, BLOB_VERSION);
+        sqlite3_bind_blob(stmt, 2, data, size, SQLITE_STATIC);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        free(data);
+    }
+    else {
+        sqlite3_prepare_v2(bench,
+            "insert into block (p, q, x, y, z, w) values (0, 0, ?, ?, ?, ?);",
+            -1, &stmt, NULL);
+        for (unsigned int i = 0; i < list.size; i++) {
+            Edit *e = list.data + i;
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, e->x);
+            sqlite3_bind_int(stmt, 2, e->y);
+            sqlite3_bind_int(stmt, 3, e->z);
+            sqlite3_bind_int(stmt, 4, e->w);
+            sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    edit_list_free(&list);
+    sqlite3_exec(bench, "commit; vacuum;", NULL, NULL, NULL);
+    return bench;
+}
+
+void db_bench(int count, int runs, DbBench *result) {
+    static const char *paths[2] = {"bench.rows.db", "bench.blob.db"};
+    static const char *queries[2] = {
+        "select x, y, z, w from block where p = 0 and q = 0;",
+        "select blocks from chunk where p = 0 and q = 0;"
+    };
+    EditList list;
+    edit_list_alloc(&list, count);
+    for (int blob = 0; blob < 2; blob++) {
+        result->load_ms[blob] = 0;
+        result->bytes[blob] = 0;
+        sqlite3 *bench = db_bench_open(paths[blob], blob, count);
+        if (!bench) {
+            continue;
+        }
+        sqlite3_stmt *stmt;
+        sqlite3_prepare_v2(bench, queries[blob], -1, &stmt, NULL);
+        clock_t start = clock();
+        for (int run = 0; run < runs; run++) {
+            Map map;
+            map_alloc(&map, 0, 0, 0, 0x7fff);
+            sqlite3_reset(stmt);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                if (!blob) {
+                    map_set(&map,
+                        sqlite3_column_int(stmt, 0),
+                        sqlite3_column_int(stmt, 1),
+                        sqlite3_column_int(stmt, 2),
+                        sqlite3_column_int(stmt, 3));
+                    continue;
+                }
+                list.size = 0;
+                blob_decode(&list, 0, 0,
+                    sqlite3_column_blob(stmt, 0),
+                    sqlite3_column_bytes(stmt, 0));
+                for (unsigned int i = 0; i < list.size; i++) {
+                    Edit *e = list.data + i;
+                    map_set(&map, e->x, e->y, e->z, e->w);
+                }
+            }
+            map_free(&map);
+        }
+        result->load_ms[blob] =
+            (double)(clock() - start) * 1000 / CLOCKS_PER_SEC / runs;
+        sqlite3_finalize(stmt);
+        sqlite3_close(bench);
+        FILE *file = fopen(paths[blob], "rb");
+        if (file) {
+            fseek(file, 0, SEEK_END);
+            result->bytes[blob] = ftell(file);
+            fclose(file);
+        }
+        remove(paths[blob]);
+    }
+    edit_list_free(&list);
+}
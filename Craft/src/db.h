@@ -1,15 +1,23 @@
 #ifndef _db_h_
 #define _db_h_
 
+#include "blob.h"
 #include "map.h"
 #include "sign.h"
 
+typedef struct {
+    double load_ms[2];
+    long long bytes[2];
+} DbBench;
+
 void db_enable();
 void db_disable();
 int get_db_enabled();
-int db_init(char *path);
+int db_init(char *path, int count);
 void db_close();
 void db_commit();
+int db_snapshot();
+int db_committed(int commit);
 void db_auth_set(char *username, char *identity_token);
 int db_auth_select(char *username);
 void db_auth_select_none();
@@ -22,17 +30,20 @@ int db_auth_get_selected(
 void db_save_state(float x, float y, float z, float rx, float ry);
 int db_load_state(float *x, float *y, float *z, float *rx, float *ry);
 void db_insert_block(int p, int q, int x, int y, int z, int w);
+void db_insert_edits(int p, int q, EditList *list);
 void db_insert_light(int p, int q, int x, int y, int z, int w);
 void db_insert_sign(
     int p, int q, int x, int y, int z, int face, const char *text);
 void db_delete_sign(int x, int y, int z, int face);
 void db_delete_signs(int x, int y, int z);
 void db_delete_all_signs();
-void db_load_blocks(Map *map, int p, int q);
-void db_load_lights(Map *map, int p, int q);
+void db_load_area(
+    int reader, int p, int q, Map *block_map, Map *light_map,
+    unsigned long long hashes[3][3]);
 void db_load_signs(SignList *list, int p, int q);
 int db_get_key(int p, int q);
 void db_set_key(int p, int q, int key);
+void db_bench(int count, int runs, DbBench *result);
 void db_worker_start();
 void db_worker_stop();
 int db_worker_run(void *arg);
@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dense.h"
+
+void dense_alloc(Dense *dense, int dx, int dz) {
+    dense->dx = dx;
+    dense->dz = dz;
+    memset(dense->sections, 0, sizeof(dense->sections));
+}
+
+static void section_release(DenseSection *section) {
+    if (section &&
+        __atomic_sub_fetch(&section->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        free(section);
+    }
+}
+
+void dense_free(Dense *dense) {
+    for (int i = 0; i < DENSE_SECTIONS; i++) {
+        section_release(dense->sections[i]);
+        dense->sections[i] = 0;
+    }
+}
+
+void dense_snapshot(Dense *dst, Dense *src) {
+    memcpy(dst, src, sizeof(Dense));
+    for (int i = 0; i < DENSE_SECTIONS; i++) {
+        DenseSection *section = src->sections[i];
+        if (section) {
+            __atomic_add_fetch(&section->refs, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+void dense_from_map(Dense *dense, Map *map) {
+    dense_alloc(dense, map->dx, map->dz);
+    MAP_FOR_EACH(map, ex, ey, ez, ew) {
+        dense_set(dense, ex, ey, ez, ew);
+    } END_MAP_FOR_EACH;
+}
+
+int dense_set(Dense *dense, int x, int y, int z, int w) {
+    x -= dense->dx;
+    z -= dense->dz;
+    if (x < 0 || x >= DENSE_SIZE) return 0;
+    if (y < 0 || y >= DENSE_SECTIONS * DENSE_HEIGHT) return 0;
+    if (z < 0 || z >= DENSE_SIZE) return 0;
+    DenseSection **slot = dense->sections + y / DENSE_HEIGHT;
+    DenseSection *section = *slot;
+    int index = DENSE_INDEX(x, y % DENSE_HEIGHT, z);
+    if (!section) {
+        if (!w) {
+            return 0;
+        }
+        section = (DenseSection *)calloc(1, sizeof(DenseSection));
+        section->refs = 1;
+        *slot = section;
+    }
+    if (section->data[index] == w) {
+        return 0;
+    }
+    if (__atomic_load_n(&section->refs, __ATOMIC_ACQUIRE) > 1) {
+        DenseSection *copy = (DenseSection *)malloc(sizeof(DenseSection));
+        memcpy(copy, section, sizeof(DenseSection));
+        copy->refs = 1;
+        section_release(section);
+        section = copy;
+        *slot = section;
+    }
+    section->count += (w != 0) - (section->data[index] != 0);
+    section->data[index] = w;
+    if (section->count == 0) {
+        section_release(section);
+        *slot = 0;
+    }
+    return 1;
+}
+
+int dense_get(Dense *dense, int x, int y, int z) {
+    x -= dense->dx;
+    z -= dense->dz;
+    if (x < 0 || x >= DENSE_SIZE) return 0;
+    if (y < 0 || y >= DENSE_SECTIONS * DENSE_HEIGHT) return 0;
+    if (z < 0 || z >= DENSE_SIZE) return 0;
+    DenseSection *section = dense->sections[y / DENSE_HEIGHT];
+    if (!section) {
+        return 0;
+    }
+    return section->data[DENSE_INDEX(x, y % DENSE_HEIGHT, z)];
+}
+
+int dense_bytes(Dense *dense) {
+    int result = 0;
+    for (int i = 0; i < DENSE_SECTIONS; i++) {
+        if (dense->sections[i]) {
+            result += sizeof(DenseSection);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,58 @@
+#ifndef _dense_h_
+#define _dense_h_
+
+#include "config.h"
+#include "map.h"
+
+// dense storage for the blocks of one chunk (plus its one block border),
+// split into horizontal sections that are only allocated once they hold
+// something; sections are reference counted and copied on write, like
+// map data, so worker snapshots are cheap
+
+#define DENSE_SIZE (CHUNK_SIZE + 2)
+#define DENSE_HEIGHT 16
+#define DENSE_SECTIONS (256 / DENSE_HEIGHT)
+#define DENSE_VOLUME (DENSE_SIZE * DENSE_SIZE * DENSE_HEIGHT)
+#define DENSE_INDEX(x, y, z) (((y) * DENSE_SIZE + (x)) * DENSE_SIZE + (z))
+
+#define DENSE_FOR_EACH(dense, ex, ey, ez, ew) \
+    for (int s = 0; s < DENSE_SECTIONS; s++) { \
+        DenseSection *section = (dense)->sections[s]; \
+        if (!section) { \
+            continue; \
+        } \
+        signed char *cell = section->data; \
+        for (int ly = 0; ly < DENSE_HEIGHT; ly++) \
+        for (int lx = 0; lx < DENSE_SIZE; lx++) \
+        for (int lz = 0; lz < DENSE_SIZE; lz++, cell++) { \
+            int ew = *cell; \
+            if (!ew) { \
+                continue; \
+            } \
+            int ex = lx + (dense)->dx; \
+            int ey = ly + s * DENSE_HEIGHT; \
+            int ez = lz + (dense)->dz;
+
+#define END_DENSE_FOR_EACH }}
+
+typedef struct {
+    unsigned int refs;
+    unsigned int count;
+    signed char data[DENSE_VOLUME];
+} DenseSection;
+
+typedef struct {
+    int dx;
+    int dz;
+    DenseSection *sections[DENSE_SECTIONS];
+} Dense;
+
+void dense_alloc(Dense *dense, int dx, int dz);
+void dense_free(Dense *dense);
+void dense_snapshot(Dense *dst, Dense *src);
+void dense_from_map(Dense *dense, Map *map);
+int dense_set(Dense *dense, int x, int y, int z, int w);
+int dense_get(Dense *dense, int x, int y, int z);
+int dense_bytes(Dense *dense);
+
+#endif
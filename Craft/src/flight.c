@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+#include "flight.h"
+
+void series_alloc(Series *series, int capacity) {
+    series->capacity = capacity;
+    series->size = 0;
+    series->data = (double *)calloc(capacity, sizeof(double));
+}
+
+void series_free(Series *series) {
+    free(series->data);
+}
+
+void series_add(Series *series, double value) {
+    if (series->size == series->capacity) {
+        series->capacity *= 2;
+        series->data = (double *)realloc(
+            series->data, series->capacity * sizeof(double));
+    }
+    series->data[series->size++] = value;
+}
+
+static int series_compare(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double series_percentile(Series *series, double percent) {
+    // sorts in place, which is fine once the run is over
+    if (!series->size) {
+        return 0;
+    }
+    qsort(series->data, series->size, sizeof(double), series_compare);
+    int index = percent / 100 * (series->size - 1) + 0.5;
+    return series->data[index];
+}
+
+static void series_write(FILE *file, const char *name, Series *series) {
+    static const double percents[] = {50, 90, 95, 99, 100};
+    double sum = 0;
+    for (unsigned int i = 0; i < series->size; i++) {
+        sum += series->data[i];
+    }
+    fprintf(file, "  \"%s\": {\"count\": %u, \"mean\": %.3f",
+        name, series->size, series->size ? sum / series->size : 0);
+    for (unsigned int i = 0; i < sizeof(percents) / sizeof(double); i++) {
+        fprintf(file, ", \"p%d\": %.3f", (int)percents[i],
+            series_percentile(series, percents[i]));
+    }
+    fprintf(file, "},\n");
+}
+
+int flight_load(Flight *flight, const char *path) {
+    // one waypoint per line: seconds, position and the two view angles in
+    // radians, with the camera moving linearly between waypoints
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    memset(flight, 0, sizeof(Flight));
+    flight->capacity = 16;
+    flight->data = (Waypoint *)calloc(flight->capacity, sizeof(Waypoint));
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        Waypoint w;
+        if (line[0] == '#' || sscanf(line, "%f %f %f %f %f %f",
+            &w.t, &w.x, &w.y, &w.z, &w.rx, &w.ry) != 6)
+        {
+            continue;
+        }
+        if (flight->size && w.t <= flight->data[flight->size - 1].t) {
+            continue;
+        }
+        if (flight->size == flight->capacity) {
+            flight->capacity *= 2;
+            flight->data = (Waypoint *)realloc(
+                flight->data, flight->capacity * sizeof(Waypoint));
+        }
+        flight->data[flight->size++] = w;
+    }
+    fclose(file);
+    if (!flight->size) {
+        free(flight->data);
+        return 0;
+    }
+    series_alloc(&flight->frame_ms, 1024);
+    series_alloc(&flight->faces, 1024);
+    series_alloc(&flight->latency_ms, 1024);
+    return 1;
+}
+
+void flight_free(Flight *flight) {
+    free(flight->data);
+    series_free(&flight->frame_ms);
+    series_free(&flight->faces);
+    series_free(&flight->latency_ms);
+}
+
+int flight_sample(
+    Flight *flight, double t,
+    float *x, float *y, float *z, float *rx, float *ry)
+{
+    Waypoint *a = flight->data;
+    Waypoint *b = flight->data;
+    for (unsigned int i = 1; i < flight->size && b->t < t; i++) {
+        a = b;
+        b = flight->data + i;
+    }
+    if (t > b->t) {
+        return 0;
+    }
+    float u = a == b ? 0 : (t - a->t) / (b->t - a->t);
+    u = u < 0 ? 0 : u;
+    *x = a->x + (b->x - a->x) * u;
+    *y = a->y + (b->y - a->y) * u;
+    *z = a->z + (b->z - a->z) * u;
+    *rx = a->rx + (b->rx - a->rx) * u;
+    *ry = a->ry + (b->ry - a->ry) * u;
+    return 1;
+}
+
+void flight_report(
+    FILE *file, Flight *flight, double elapsed,
+    double *busy, int worker_count)
+{
+    double total = 0;
+    fprintf(file, "{\n");
+    fprintf(file, "  \"frames\": %d,\n", flight->frame);
+    fprintf(file, "  \"seconds\": %.3f,\n", elapsed);
+    series_write(file, "frame_ms", &flight->frame_ms);
+    series_write(file, "faces", &flight->faces);
+    series_write(file, "chunk_latency_ms", &flight->latency_ms);
+    fprintf(file, "  \"worker_utilization\": [");
+    for (int i = 0; i < worker_count; i++) {
+        total += busy[i];
+        fprintf(file, "%s%.3f", i ? ", " : "",
+            elapsed > 0 ? busy[i] / elapsed : 0);
+    }
+    fprintf(file, "],\n");
+    fprintf(file, "  \"utilization\": %.3f\n",
+        elapsed > 0 && worker_count ? total / elapsed / worker_count : 0);
+    fprintf(file, "}\n");
+}
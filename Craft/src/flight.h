@@ -0,0 +1,50 @@
+#ifndef _flight_h_
+#define _flight_h_
+
+#include <stdio.h>
+
+// a scripted camera path and the measurements taken while flying along it,
+// so the same run can be repeated without input and compared across builds
+
+#define FLIGHT_STEP (1.0 / 60)
+
+typedef struct {
+    float t;
+    float x;
+    float y;
+    float z;
+    float rx;
+    float ry;
+} Waypoint;
+
+typedef struct {
+    unsigned int capacity;
+    unsigned int size;
+    double *data;
+} Series;
+
+typedef struct {
+    unsigned int capacity;
+    unsigned int size;
+    Waypoint *data;
+    int frame;
+    Series frame_ms;
+    Series faces;
+    Series latency_ms;
+} Flight;
+
+void series_alloc(Series *series, int capacity);
+void series_free(Series *series);
+void series_add(Series *series, double value);
+double series_percentile(Series *series, double percent);
+
+int flight_load(Flight *flight, const char *path);
+void flight_free(Flight *flight);
+int flight_sample(
+    Flight *flight, double t,
+    float *x, float *y, float *z, float *rx, float *ry);
+void flight_report(
+    FILE *file, Flight *flight, double elapsed,
+    double *busy, int worker_count);
+
+#endif
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+#include "heap.h"
+
+void heap_alloc(Heap *heap, int capacity) {
+    heap->capacity = capacity;
+    heap->size = 0;
+    heap->data = (HeapEntry *)calloc(capacity, sizeof(HeapEntry));
+}
+
+void heap_free(Heap *heap) {
+    free(heap->data);
+}
+
+void heap_grow(Heap *heap) {
+    Heap new_heap;
+    heap_alloc(&new_heap, heap->capacity * 2);
+    memcpy(new_heap.data, heap->data, heap->size * sizeof(HeapEntry));
+    free(heap->data);
+    heap->capacity = new_heap.capacity;
+    heap->data = new_heap.data;
+}
+
+void heap_push(Heap *heap, int score, void *data) {
+    if (heap->size == heap->capacity) {
+        heap_grow(heap);
+    }
+    unsigned int i = heap->size++;
+    while (i > 0) {
+        unsigned int parent = (i - 1) / 2;
+        if (heap->data[parent].score <= score) {
+            break;
+        }
+        heap->data[i] = heap->data[parent];
+        i = parent;
+    }
+    heap->data[i].score = score;
+    heap->data[i].data = data;
+}
+
+int heap_peek(Heap *heap, int *score) {
+    if (heap->size == 0) {
+        return 0;
+    }
+    *score = heap->data[0].score;
+    return 1;
+}
+
+int heap_pop(Heap *heap, int *score, void **data) {
+    if (heap->size == 0) {
+        return 0;
+    }
+    if (score) {
+        *score = heap->data[0].score;
+    }
+    *data = heap->data[0].data;
+    HeapEntry last = heap->data[--heap->size];
+    unsigned int i = 0;
+    while (1) {
+        unsigned int child = i * 2 + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size &&
+            heap->data[child + 1].score < heap->data[child].score)
+        {
+            child++;
+        }
+        if (last.score <= heap->data[child].score) {
+            break;
+        }
+        heap->data[i] = heap->data[child];
+        i = child;
+    }
+    heap->data[i] = last;
+    return 1;
+}
@@ -0,0 +1,22 @@
+#ifndef _heap_h_
+#define _heap_h_
+
+typedef struct {
+    int score;
+    void *data;
+} HeapEntry;
+
+typedef struct {
+    unsigned int capacity;
+    unsigned int size;
+    HeapEntry *data;
+} Heap;
+
+void heap_alloc(Heap *heap, int capacity);
+void heap_free(Heap *heap);
+void heap_grow(Heap *heap);
+void heap_push(Heap *heap, int score, void *data);
+int heap_peek(Heap *heap, int *score);
+int heap_pop(Heap *heap, int *score, void **data);
+
+#endif
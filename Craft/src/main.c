@@ -6,27 +6,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "ao.h"
+#include "arena.h"
 #include "auth.h"
+#include "blob.h"
+#include "cache.h"
 #include "client.h"
 #include "config.h"
 #include "cube.h"
 #include "db.h"
+#include "dense.h"
+#include "flight.h"
+#include "heap.h"
 #include "item.h"
 #include "map.h"
 #include "matrix.h"
+#include "mesh.h"
 #include "noise.h"
+#include "pool.h"
+#include "queue.h"
 #include "sign.h"
+#include "table.h"
 #include "tinycthread.h"
 #include "util.h"
 #include "world.h"
 
 #define MAX_CHUNKS 8192
 #define MAX_PLAYERS 128
-#define WORKERS 4
+#define MAX_WORKERS 64
+#define JOBS_PER_WORKER 4
 #define MAX_TEXT_LENGTH 256
 #define MAX_NAME_LENGTH 32
 #define MAX_PATH_LENGTH 256
 #define MAX_ADDR_LENGTH 256
+#define MAX_BATCH 1024
+#define MAX_PAGES 1024
+#define MAX_LODS 2048
+#define HEIGHT_SIZE (CHUNK_SIZE + 2)
+#define PAGE_BYTES (4 * 1024 * 1024)
 
 #define ALIGN_LEFT 0
 #define ALIGN_CENTER 1
@@ -35,53 +52,86 @@
 #define MODE_OFFLINE 0
 #define MODE_ONLINE 1
 
-#define WORKER_IDLE 0
-#define WORKER_BUSY 1
-#define WORKER_DONE 2
+typedef struct {
+    int faces;
+    int miny;
+    int maxy;
+    int page;
+    int offset;
+    int capacity;
+    int connect;
+    int visited;
+} Section;
 
 typedef struct {
     Map map;
     Map lights;
+    Dense dense;
+    Dense light_field;
     SignList signs;
     int p;
     int q;
     int faces;
     int sign_faces;
     int dirty;
+    int dirty_sections;
+    int busy;
+    int lit;
+    int cached;
+    int partial;
     int miny;
     int maxy;
+    double requested;
+    int meshed;
+    Section sections[MESH_SECTIONS];
+    short heights[HEIGHT_SIZE * HEIGHT_SIZE];
     GLuint buffer;
     GLuint sign_buffer;
 } Chunk;
 
 typedef struct {
+    int rp;
+    int rq;
+    GLuint buffer;
+    Arena arena;
+    int start;
+    int draws;
+} Page;
+
+typedef struct {
+    int level;
     int p;
     int q;
-    int load;
-    Map *block_maps[3][3];
-    Map *light_maps[3][3];
-    int miny;
-    int maxy;
     int faces;
-    GLfloat *data;
-} WorkerItem;
+    int maxy;
+    int busy;
+    int frame;
+    GLuint buffer;
+} Lod;
+
+typedef struct {
+    int head;
+    int size;
+    int capacity;
+    Block *data;
+} LightQueue;
+
+typedef struct {
+    Chunk *chunk;
+    int section;
+    int from;
+    int dirs;
+} CullNode;
 
 typedef struct {
     int index;
-    int state;
     thrd_t thrd;
     mtx_t mtx;
-    cnd_t cnd;
-    WorkerItem item;
+    Heap jobs;
+    Scratch scratch;
+    double busy;
 } Worker;
 
-typedef struct {
-    int x;
-    int y;
-    int z;
-    int w;
-} Block;
-
 typedef struct {
     float x;
     float y;
@@ -113,13 +163,48 @@ typedef struct {
     GLuint extra2;
     GLuint extra3;
     GLuint extra4;
+    GLuint extra5;
 } Attrib;
 
+typedef struct {
+    double since;
+    unsigned long long copied;
+    unsigned long long shared;
+    double copied_rate;
+    double shared_rate;
+} Stats;
+
 typedef struct {
     GLFWwindow *window;
-    Worker workers[WORKERS];
+    Worker workers[MAX_WORKERS];
+    int worker_count;
+    mtx_t job_mtx;
+    cnd_t job_cnd;
+    int job_pending;
+    int job_count;
+    int job_next;
+    Queue done;
+    Pool pool;
+    Scratch scratch;
+    int job_allocs;
     Chunk chunks[MAX_CHUNKS];
     int chunk_count;
+    Table chunk_table;
+    GLuint index_buffer;
+    int index_faces;
+    Page pages[MAX_PAGES];
+    Section *visible[MAX_CHUNKS * MESH_SECTIONS];
+    GLint draw_first[MAX_CHUNKS * MESH_SECTIONS];
+    GLsizei draw_count[MAX_CHUNKS * MESH_SECTIONS];
+    GLvoid *draw_indices[MAX_CHUNKS * MESH_SECTIONS];
+    CullNode cull_queue[MAX_CHUNKS * MESH_SECTIONS];
+    int cull_frame;
+    int frustum_faces;
+    Lod lods[MAX_LODS];
+    int lod_count;
+    int lod_frame;
+    int lod_faces;
+    Table lod_tables[LOD_LEVELS + 1];
     int create_radius;
     int render_radius;
     int delete_radius;
@@ -147,6 +232,16 @@ typedef struct {
     int server_port;
     int day_length;
     int time_changed;
+    EditList batch;
+    int batch_p;
+    int batch_q;
+    EditList changed;
+    int editing;
+    Table edit_table;
+    EditList edit_blocks;
+    FILE *capture;
+    int benchmark;
+    Flight flight;
     Block block0;
     Block block1;
     Block copy0;
@@ -183,6 +278,20 @@ float get_daylight() {
     }
 }
 
+void update_stats(Stats *stats) {
+    double now = glfwGetTime();
+    double elapsed = now - stats->since;
+    if (elapsed >= 1) {
+        unsigned long long copied = map_copied_bytes();
+        unsigned long long shared = map_shared_bytes();
+        stats->copied_rate = (copied - stats->copied) / elapsed;
+        stats->shared_rate = (shared - stats->shared) / elapsed;
+        stats->copied = copied;
+        stats->shared = shared;
+        stats->since = now;
+    }
+}
+
 int get_scale_factor() {
     int window_width, window_height;
     int buffer_width, buffer_height;
@@ -311,6 +420,66 @@ void draw_triangles_3d_ao(Attrib *attrib, GLuint buffer, int count) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void draw_triangles_3d_packed(Attrib *attrib, GLuint buffer, int count) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(attrib->position);
+    glEnableVertexAttribArray(attrib->normal);
+    glEnableVertexAttribArray(attrib->uv);
+    glVertexAttribPointer(attrib->position, 3, GL_SHORT, GL_FALSE,
+        sizeof(PackedVertex), 0);
+    glVertexAttribPointer(attrib->normal, 2, GL_UNSIGNED_BYTE, GL_FALSE,
+        sizeof(PackedVertex), (GLvoid *)(sizeof(GLshort) * 3));
+    glVertexAttribPointer(attrib->uv, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+        sizeof(PackedVertex), (GLvoid *)(sizeof(GLshort) * 3 + 2));
+    glDrawArrays(GL_TRIANGLES, 0, count);
+    glDisableVertexAttribArray(attrib->position);
+    glDisableVertexAttribArray(attrib->normal);
+    glDisableVertexAttribArray(attrib->uv);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_quads(int faces) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g->index_buffer);
+    glDrawElements(GL_TRIANGLES, faces * 6, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void draw_quads_3d_ao(Attrib *attrib, GLuint buffer, int faces) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(attrib->position);
+    glEnableVertexAttribArray(attrib->normal);
+    glEnableVertexAttribArray(attrib->uv);
+    glVertexAttribPointer(attrib->position, 3, GL_FLOAT, GL_FALSE,
+        sizeof(GLfloat) * 10, 0);
+    glVertexAttribPointer(attrib->normal, 3, GL_FLOAT, GL_FALSE,
+        sizeof(GLfloat) * 10, (GLvoid *)(sizeof(GLfloat) * 3));
+    glVertexAttribPointer(attrib->uv, 4, GL_FLOAT, GL_FALSE,
+        sizeof(GLfloat) * 10, (GLvoid *)(sizeof(GLfloat) * 6));
+    draw_quads(faces);
+    glDisableVertexAttribArray(attrib->position);
+    glDisableVertexAttribArray(attrib->normal);
+    glDisableVertexAttribArray(attrib->uv);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_quads_3d_packed(Attrib *attrib, GLuint buffer, int faces) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(attrib->position);
+    glEnableVertexAttribArray(attrib->normal);
+    glEnableVertexAttribArray(attrib->uv);
+    glVertexAttribPointer(attrib->position, 3, GL_SHORT, GL_FALSE,
+        sizeof(PackedVertex), 0);
+    glVertexAttribPointer(attrib->normal, 2, GL_UNSIGNED_BYTE, GL_FALSE,
+        sizeof(PackedVertex), (GLvoid *)(sizeof(GLshort) * 3));
+    glVertexAttribPointer(attrib->uv, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+        sizeof(PackedVertex), (GLvoid *)(sizeof(GLshort) * 3 + 2));
+    draw_quads(faces);
+    glDisableVertexAttribArray(attrib->position);
+    glDisableVertexAttribArray(attrib->normal);
+    glDisableVertexAttribArray(attrib->uv);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 void draw_triangles_3d_text(Attrib *attrib, GLuint buffer, int count) {
     glBindBuffer(GL_ARRAY_BUFFER, buffer);
     glEnableVertexAttribArray(attrib->position);
@@ -367,8 +536,113 @@ void draw_lines(Attrib *attrib, GLuint buffer, int components, int count) {
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
+void draw_mesh(Attrib *attrib, GLuint buffer, int faces, int p, int q) {
+    if (PACKED_VERTICES) {
+        glUniform3f(attrib->extra5,
+            mesh_region(p) * MESH_REGION * CHUNK_SIZE, 0,
+            mesh_region(q) * MESH_REGION * CHUNK_SIZE);
+    }
+    if (PACKED_VERTICES && INDEXED_QUADS) {
+        draw_quads_3d_packed(attrib, buffer, faces);
+    }
+    else if (PACKED_VERTICES) {
+        draw_triangles_3d_packed(attrib, buffer, faces * 6);
+    }
+    else if (INDEXED_QUADS) {
+        draw_quads_3d_ao(attrib, buffer, faces);
+    }
+    else {
+        draw_triangles_3d_ao(attrib, buffer, faces * 6);
+    }
+}
+
 void draw_chunk(Attrib *attrib, Chunk *chunk) {
-    draw_triangles_3d_ao(attrib, chunk->buffer, chunk->faces * 6);
+    draw_mesh(attrib, chunk->buffer, chunk->faces, chunk->p, chunk->q);
+}
+
+void page_attributes(Attrib *attrib, int offset) {
+    if (PACKED_VERTICES) {
+        size_t size = sizeof(PackedVertex);
+        glVertexAttribPointer(attrib->position, 3, GL_SHORT, GL_FALSE,
+            size, (GLvoid *)(size * offset));
+        glVertexAttribPointer(attrib->normal, 2, GL_UNSIGNED_BYTE, GL_FALSE,
+            size, (GLvoid *)(size * offset + sizeof(GLshort) * 3));
+        glVertexAttribPointer(attrib->uv, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+            size, (GLvoid *)(size * offset + sizeof(GLshort) * 3 + 2));
+    }
+    else {
+        size_t size = sizeof(GLfloat) * 10;
+        glVertexAttribPointer(attrib->position, 3, GL_FLOAT, GL_FALSE,
+            size, (GLvoid *)(size * offset));
+        glVertexAttribPointer(attrib->normal, 3, GL_FLOAT, GL_FALSE,
+            size, (GLvoid *)(size * offset + sizeof(GLfloat) * 3));
+        glVertexAttribPointer(attrib->uv, 4, GL_FLOAT, GL_FALSE,
+            size, (GLvoid *)(size * offset + sizeof(GLfloat) * 6));
+    }
+}
+
+void draw_page(Attrib *attrib, Page *page) {
+    GLint *first = g->draw_first + page->start;
+    GLsizei *count = g->draw_count + page->start;
+    glUniform3f(attrib->extra5,
+        page->rp * MESH_REGION * CHUNK_SIZE, 0,
+        page->rq * MESH_REGION * CHUNK_SIZE);
+    glBindBuffer(GL_ARRAY_BUFFER, page->buffer);
+    glEnableVertexAttribArray(attrib->position);
+    glEnableVertexAttribArray(attrib->normal);
+    glEnableVertexAttribArray(attrib->uv);
+    if (INDEXED_QUADS && !GLEW_ARB_draw_elements_base_vertex) {
+        // without base vertices each chunk needs its own attribute offsets
+        for (int i = 0; i < page->draws; i++) {
+            page_attributes(attrib, first[i]);
+            draw_quads(count[i] / 6);
+        }
+    }
+    else if (INDEXED_QUADS) {
+        page_attributes(attrib, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g->index_buffer);
+        glMultiDrawElementsBaseVertex(
+            GL_TRIANGLES, count, GL_UNSIGNED_INT,
+            g->draw_indices + page->start, page->draws, first);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    else {
+        page_attributes(attrib, 0);
+        glMultiDrawArrays(GL_TRIANGLES, first, count, page->draws);
+    }
+    glDisableVertexAttribArray(attrib->position);
+    glDisableVertexAttribArray(attrib->normal);
+    glDisableVertexAttribArray(attrib->uv);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void draw_chunks(Attrib *attrib, Section **sections, int count) {
+    // the visible sections are bucketed by page, then every page is drawn
+    // with one call however many sections it holds
+    for (int i = 0; i < MAX_PAGES; i++) {
+        g->pages[i].draws = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        g->pages[sections[i]->page].draws++;
+    }
+    int start = 0;
+    for (int i = 0; i < MAX_PAGES; i++) {
+        g->pages[i].start = start;
+        start += g->pages[i].draws;
+        g->pages[i].draws = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        Page *page = g->pages + sections[i]->page;
+        int index = page->start + page->draws++;
+        g->draw_first[index] = sections[i]->offset;
+        g->draw_count[index] = sections[i]->faces * 6;
+        g->draw_indices[index] = 0;
+    }
+    for (int i = 0; i < MAX_PAGES; i++) {
+        if (g->pages[i].draws) {
+            draw_page(attrib, g->pages + i);
+        }
+    }
 }
 
 void draw_item(Attrib *attrib, GLuint buffer, int count) {
@@ -526,13 +800,30 @@ Player *player_crosshair(Player *player) {
 }
 
 Chunk *find_chunk(int p, int q) {
-    for (int i = 0; i < g->chunk_count; i++) {
-        Chunk *chunk = g->chunks + i;
-        if (chunk->p == p && chunk->q == q) {
-            return chunk;
+    return (Chunk *)table_get(&g->chunk_table, p, q);
+}
+
+int chunk_get(Chunk *chunk, int x, int y, int z) {
+    if (DENSE_STORAGE) {
+        return dense_get(&chunk->dense, x, y, z);
+    }
+    return map_get(&chunk->map, x, y, z);
+}
+
+int chunk_complete(Chunk *chunk) {
+    // every neighbor a mesh reads from has arrived
+    for (int dp = -1; dp <= 1; dp++) {
+        for (int dq = -1; dq <= 1; dq++) {
+            if (!dp && !dq) {
+                continue;
+            }
+            Chunk *other = find_chunk(chunk->p + dp, chunk->q + dq);
+            if (!other || !other->lit) {
+                return 0;
+            }
         }
     }
-    return 0;
+    return 1;
 }
 
 int chunk_distance(Chunk *chunk, int p, int q) {
@@ -541,10 +832,17 @@ int chunk_distance(Chunk *chunk, int p, int q) {
     return MAX(dp, dq);
 }
 
-int chunk_visible(float planes[6][4], int p, int q, int miny, int maxy) {
+int view_radius() {
+    // far terrain widens the view by a factor of two per level
+    return g->render_radius << LOD_LEVELS;
+}
+
+int area_visible(
+    float planes[6][4], int p, int q, int span, int miny, int maxy)
+{
     int x = p * CHUNK_SIZE - 1;
     int z = q * CHUNK_SIZE - 1;
-    int d = CHUNK_SIZE + 1;
+    int d = span * CHUNK_SIZE + 1;
     float points[8][3] = {
         {x + 0, miny, z + 0},
         {x + d, miny, z + 0},
@@ -582,85 +880,109 @@ int chunk_visible(float planes[6][4], int p, int q, int miny, int maxy) {
     return 1;
 }
 
-int highest_block(float x, float z) {
-    int result = -1;
-    int nx = roundf(x);
-    int nz = roundf(z);
-    int p = chunked(x);
-    int q = chunked(z);
-    Chunk *chunk = find_chunk(p, q);
-    if (chunk) {
-        Map *map = &chunk->map;
-        MAP_FOR_EACH(map, ex, ey, ez, ew) {
-            if (is_obstacle(ew) && ex == nx && ez == nz) {
-                result = MAX(result, ey);
-            }
-        } END_MAP_FOR_EACH;
+int chunk_visible(float planes[6][4], int p, int q, int miny, int maxy) {
+    return area_visible(planes, p, q, 1, miny, maxy);
+}
+
+int chunk_height(Chunk *chunk, int x, int z) {
+    int a = x - chunk->p * CHUNK_SIZE + 1;
+    int b = z - chunk->q * CHUNK_SIZE + 1;
+    if (a < 0 || b < 0 || a >= HEIGHT_SIZE || b >= HEIGHT_SIZE) {
+        return -1;
     }
-    return result;
+    return chunk->heights[a * HEIGHT_SIZE + b];
 }
 
-int _hit_test(
-    Map *map, float max_distance, int previous,
-    float x, float y, float z,
-    float vx, float vy, float vz,
-    int *hx, int *hy, int *hz)
-{
-    int m = 32;
-    int px = 0;
-    int py = 0;
-    int pz = 0;
-    for (int i = 0; i < max_distance * m; i++) {
-        int nx = roundf(x);
-        int ny = roundf(y);
-        int nz = roundf(z);
-        if (nx != px || ny != py || nz != pz) {
-            int hw = map_get(map, nx, ny, nz);
-            if (hw > 0) {
-                if (previous) {
-                    *hx = px; *hy = py; *hz = pz;
-                }
-                else {
-                    *hx = nx; *hy = ny; *hz = nz;
-                }
-                return hw;
-            }
-            px = nx; py = ny; pz = nz;
+void update_height(Chunk *chunk, int x, int y, int z, int w) {
+    // keeps the highest obstacle of every column the chunk stores, its
+    // one block border included; digging out the top scans down once
+    int a = x - chunk->p * CHUNK_SIZE + 1;
+    int b = z - chunk->q * CHUNK_SIZE + 1;
+    if (a < 0 || b < 0 || a >= HEIGHT_SIZE || b >= HEIGHT_SIZE) {
+        return;
+    }
+    short *height = chunk->heights + a * HEIGHT_SIZE + b;
+    if (is_obstacle(w)) {
+        *height = MAX(*height, y);
+    }
+    else if (y == *height) {
+        int ny = y - 1;
+        while (ny >= 0 && !is_obstacle(chunk_get(chunk, x, ny, z))) {
+            ny--;
         }
-        x += vx / m; y += vy / m; z += vz / m;
+        *height = ny;
     }
-    return 0;
+}
+
+void compute_heights(Chunk *chunk) {
+    for (int i = 0; i < HEIGHT_SIZE * HEIGHT_SIZE; i++) {
+        chunk->heights[i] = -1;
+    }
+    Map *map = &chunk->map;
+    MAP_FOR_EACH(map, ex, ey, ez, ew) {
+        if (is_obstacle(ew)) {
+            update_height(chunk, ex, ey, ez, ew);
+        }
+    } END_MAP_FOR_EACH;
+}
+
+int highest_block(float x, float z) {
+    Chunk *chunk = find_chunk(chunked(x), chunked(z));
+    if (!chunk) {
+        return -1;
+    }
+    return chunk_height(chunk, roundf(x), roundf(z));
 }
 
 int hit_test(
     int previous, float x, float y, float z, float rx, float ry,
     int *bx, int *by, int *bz)
 {
-    int result = 0;
-    float best = 0;
-    int p = chunked(x);
-    int q = chunked(z);
-    float vx, vy, vz;
-    get_sight_vector(rx, ry, &vx, &vy, &vz);
-    for (int i = 0; i < g->chunk_count; i++) {
-        Chunk *chunk = g->chunks + i;
-        if (chunk_distance(chunk, p, q) > 1) {
-            continue;
+    // steps through every block the sight line enters, in order, up to
+    // 8 blocks away (Amanatides and Woo), reading each from its own
+    // chunk so that the walk crosses chunk borders on its own
+    float max_distance = 8;
+    float v[3];
+    get_sight_vector(rx, ry, v + 0, v + 1, v + 2);
+    float origin[3] = {x + 0.5, y + 0.5, z + 0.5};
+    int block[3];
+    int step[3];
+    float delta[3];
+    float next[3];
+    for (int i = 0; i < 3; i++) {
+        block[i] = floorf(origin[i]);
+        step[i] = v[i] > 0 ? 1 : -1;
+        delta[i] = v[i] ? fabsf(1 / v[i]) : INFINITY;
+        float edge = v[i] > 0 ?
+            block[i] + 1 - origin[i] : origin[i] - block[i];
+        next[i] = v[i] ? edge * delta[i] : INFINITY;
+    }
+    int last[3] = {block[0], block[1], block[2]};
+    Chunk *chunk = 0;
+    float t = 0;
+    while (t <= max_distance) {
+        int p = chunked(block[0]);
+        int q = chunked(block[2]);
+        if (!chunk || chunk->p != p || chunk->q != q) {
+            chunk = find_chunk(p, q);
+        }
+        int hw = 0;
+        if (chunk && block[1] >= 0 && block[1] < 256) {
+            hw = chunk_get(chunk, block[0], block[1], block[2]);
         }
-        int hx, hy, hz;
-        int hw = _hit_test(&chunk->map, 8, previous,
-            x, y, z, vx, vy, vz, &hx, &hy, &hz);
         if (hw > 0) {
-            float d = sqrtf(
-                powf(hx - x, 2) + powf(hy - y, 2) + powf(hz - z, 2));
-            if (best == 0 || d < best) {
-                best = d;
-                *bx = hx; *by = hy; *bz = hz;
-                result = hw;
-            }
+            int *result = previous ? last : block;
+            *bx = result[0]; *by = result[1]; *bz = result[2];
+            return hw;
         }
+        memcpy(last, block, sizeof(last));
+        int axis = next[0] < next[1] ?
+            (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+        t = next[axis];
+        block[axis] += step[axis];
+        next[axis] += delta[axis];
     }
-    return result;
+    return 0;
 }
 
 int hit_test_face(Player *player, int *x, int *y, int *z, int *face) {
@@ -704,33 +1026,42 @@ int collide(int height, float *x, float *y, float *z) {
     if (!chunk) {
         return result;
     }
-    Map *map = &chunk->map;
     int nx = roundf(*x);
     int ny = roundf(*y);
     int nz = roundf(*z);
+    // nothing to collide with while the lowest block checked is above
+    // the highest obstacle of all five columns
+    int top = chunk_height(chunk, nx, nz);
+    top = MAX(top, chunk_height(chunk, nx - 1, nz));
+    top = MAX(top, chunk_height(chunk, nx + 1, nz));
+    top = MAX(top, chunk_height(chunk, nx, nz - 1));
+    top = MAX(top, chunk_height(chunk, nx, nz + 1));
+    if (ny - height > top) {
+        return result;
+    }
     float px = *x - nx;
     float py = *y - ny;
     float pz = *z - nz;
     float pad = 0.25;
     for (int dy = 0; dy < height; dy++) {
-        if (px < -pad && is_obstacle(map_get(map, nx - 1, ny - dy, nz))) {
+        if (px < -pad && is_obstacle(chunk_get(chunk, nx - 1, ny - dy, nz))) {
             *x = nx - pad;
         }
-        if (px > pad && is_obstacle(map_get(map, nx + 1, ny - dy, nz))) {
+        if (px > pad && is_obstacle(chunk_get(chunk, nx + 1, ny - dy, nz))) {
             *x = nx + pad;
         }
-        if (py < -pad && is_obstacle(map_get(map, nx, ny - dy - 1, nz))) {
+        if (py < -pad && is_obstacle(chunk_get(chunk, nx, ny - dy - 1, nz))) {
             *y = ny - pad;
             result = 1;
         }
-        if (py > pad && is_obstacle(map_get(map, nx, ny - dy + 1, nz))) {
+        if (py > pad && is_obstacle(chunk_get(chunk, nx, ny - dy + 1, nz))) {
             *y = ny + pad;
             result = 1;
         }
-        if (pz < -pad && is_obstacle(map_get(map, nx, ny - dy, nz - 1))) {
+        if (pz < -pad && is_obstacle(chunk_get(chunk, nx, ny - dy, nz - 1))) {
             *z = nz - pad;
         }
-        if (pz > pad && is_obstacle(map_get(map, nx, ny - dy, nz + 1))) {
+        if (pz > pad && is_obstacle(chunk_get(chunk, nx, ny - dy, nz + 1))) {
             *z = nz + pad;
         }
     }
@@ -840,305 +1171,175 @@ void gen_sign_buffer(Chunk *chunk) {
     chunk->sign_faces = faces;
 }
 
-int has_lights(Chunk *chunk) {
-    if (!SHOW_LIGHTS) {
-        return 0;
-    }
-    for (int dp = -1; dp <= 1; dp++) {
-        for (int dq = -1; dq <= 1; dq++) {
-            Chunk *other = chunk;
-            if (dp || dq) {
-                other = find_chunk(chunk->p + dp, chunk->q + dq);
-            }
-            if (!other) {
-                continue;
-            }
-            Map *map = &other->lights;
-            if (map->size) {
-                return 1;
-            }
-        }
-    }
-    return 0;
+void dirty_chunk(Chunk *chunk) {
+    chunk->dirty = 1;
+    chunk->dirty_sections = SECTION_MASK;
 }
 
-void dirty_chunk(Chunk *chunk) {
+void dirty_height(Chunk *chunk, int y) {
+    // a block changes the faces and light of the blocks next to it and
+    // the sky shade of the few below, which may reach the next section
     chunk->dirty = 1;
-    if (has_lights(chunk)) {
-        for (int dp = -1; dp <= 1; dp++) {
-            for (int dq = -1; dq <= 1; dq++) {
-                Chunk *other = find_chunk(chunk->p + dp, chunk->q + dq);
-                if (other) {
-                    other->dirty = 1;
-                }
-            }
-        }
+    for (int s = mesh_section(y - 8); s <= mesh_section(y + 1); s++) {
+        chunk->dirty_sections |= 1 << s;
     }
 }
 
-void occlusion(
-    char neighbors[27], char lights[27], float shades[27],
-    float ao[6][4], float light[6][4])
-{
-    static const int lookup3[6][4][3] = {
-        {{0, 1, 3}, {2, 1, 5}, {6, 3, 7}, {8, 5, 7}},
-        {{18, 19, 21}, {20, 19, 23}, {24, 21, 25}, {26, 23, 25}},
-        {{6, 7, 15}, {8, 7, 17}, {24, 15, 25}, {26, 17, 25}},
-        {{0, 1, 9}, {2, 1, 11}, {18, 9, 19}, {20, 11, 19}},
-        {{0, 3, 9}, {6, 3, 15}, {18, 9, 21}, {24, 15, 21}},
-        {{2, 5, 11}, {8, 5, 17}, {20, 11, 23}, {26, 17, 23}}
-    };
-   static const int lookup4[6][4][4] = {
-        {{0, 1, 3, 4}, {1, 2, 4, 5}, {3, 4, 6, 7}, {4, 5, 7, 8}},
-        {{18, 19, 21, 22}, {19, 20, 22, 23}, {21, 22, 24, 25}, {22, 23, 25, 26}},
-        {{6, 7, 15, 16}, {7, 8, 16, 17}, {15, 16, 24, 25}, {16, 17, 25, 26}},
-        {{0, 1, 9, 10}, {1, 2, 10, 11}, {9, 10, 18, 19}, {10, 11, 19, 20}},
-        {{0, 3, 9, 12}, {3, 6, 12, 15}, {9, 12, 18, 21}, {12, 15, 21, 24}},
-        {{2, 5, 11, 14}, {5, 8, 14, 17}, {11, 14, 20, 23}, {14, 17, 23, 26}}
-    };
-    static const float curve[4] = {0.0, 0.25, 0.5, 0.75};
-    for (int i = 0; i < 6; i++) {
-        for (int j = 0; j < 4; j++) {
-            int corner = neighbors[lookup3[i][j][0]];
-            int side1 = neighbors[lookup3[i][j][1]];
-            int side2 = neighbors[lookup3[i][j][2]];
-            int value = side1 && side2 ? 3 : corner + side1 + side2;
-            float shade_sum = 0;
-            float light_sum = 0;
-            int is_light = lights[13] == 15;
-            for (int k = 0; k < 4; k++) {
-                shade_sum += shades[lookup4[i][j][k]];
-                light_sum += lights[lookup4[i][j][k]];
-            }
-            if (is_light) {
-                light_sum = 15 * 4 * 10;
-            }
-            float total = curve[value] + shade_sum / 4.0;
-            ao[i][j] = MIN(total, 1.0);
-            light[i][j] = light_sum / 15.0 / 4.0;
-        }
-    }
-}
-
-#define XZ_SIZE (CHUNK_SIZE * 3 + 2)
-#define XZ_LO (CHUNK_SIZE)
-#define XZ_HI (CHUNK_SIZE * 2 + 1)
-#define Y_SIZE 258
-#define XYZ(x, y, z) ((y) * XZ_SIZE * XZ_SIZE + (x) * XZ_SIZE + (z))
-#define XZ(x, z) ((x) * XZ_SIZE + (z))
-
-void light_fill(
-    char *opaque, char *light,
-    int x, int y, int z, int w, int force)
-{
-    if (x + w < XZ_LO || z + w < XZ_LO) {
+int take_sections(Chunk *chunk) {
+    // a single buffer per chunk can only be replaced as a whole
+    int result = CHUNK_ARENA ? chunk->dirty_sections : SECTION_MASK;
+    chunk->dirty = 0;
+    chunk->dirty_sections = 0;
+    return result;
+}
+
+void ensure_index_buffer(int faces) {
+    // one shared index buffer covers every chunk up to the largest so far
+    if (faces <= g->index_faces) {
         return;
     }
-    if (x - w > XZ_HI || z - w > XZ_HI) {
+    int capacity = MAX(g->index_faces, 1024);
+    while (capacity < faces) {
+        capacity <<= 1;
+    }
+    GLuint *data = malloc(sizeof(GLuint) * 6 * capacity);
+    for (int i = 0; i < capacity; i++) {
+        GLuint *d = data + i * 6;
+        d[0] = i * 4; d[1] = i * 4 + 1; d[2] = i * 4 + 2;
+        d[3] = i * 4; d[4] = i * 4 + 2; d[5] = i * 4 + 3;
+    }
+    del_buffer(g->index_buffer);
+    glGenBuffers(1, &g->index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g->index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+        sizeof(GLuint) * 6 * capacity, data, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(data);
+    g->index_faces = capacity;
+}
+
+void release_section_buffer(Section *section) {
+    if (section->page < 0) {
         return;
     }
-    if (y < 0 || y >= Y_SIZE) {
-        return;
+    Page *page = g->pages + section->page;
+    arena_give(&page->arena, section->offset, section->capacity);
+    if (!page->arena.used) {
+        del_buffer(page->buffer);
+        arena_free(&page->arena);
+        page->buffer = 0;
     }
-    if (light[XYZ(x, y, z)] >= w) {
+    section->page = -1;
+}
+
+void release_chunk_buffer(Chunk *chunk) {
+    if (!CHUNK_ARENA) {
+        del_buffer(chunk->buffer);
+        chunk->buffer = 0;
         return;
     }
-    if (!force && opaque[XYZ(x, y, z)]) {
-        return;
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        release_section_buffer(chunk->sections + i);
     }
-    light[XYZ(x, y, z)] = w--;
-    light_fill(opaque, light, x - 1, y, z, w, 0);
-    light_fill(opaque, light, x + 1, y, z, w, 0);
-    light_fill(opaque, light, x, y - 1, z, w, 0);
-    light_fill(opaque, light, x, y + 1, z, w, 0);
-    light_fill(opaque, light, x, y, z - 1, w, 0);
-    light_fill(opaque, light, x, y, z + 1, w, 0);
 }
 
-void compute_chunk(WorkerItem *item) {
-    char *opaque = (char *)calloc(XZ_SIZE * XZ_SIZE * Y_SIZE, sizeof(char));
-    char *light = (char *)calloc(XZ_SIZE * XZ_SIZE * Y_SIZE, sizeof(char));
-    char *highest = (char *)calloc(XZ_SIZE * XZ_SIZE, sizeof(char));
-
-    int ox = item->p * CHUNK_SIZE - CHUNK_SIZE - 1;
-    int oy = -1;
-    int oz = item->q * CHUNK_SIZE - CHUNK_SIZE - 1;
-
-    // check for lights
-    int has_light = 0;
-    if (SHOW_LIGHTS) {
-        for (int a = 0; a < 3; a++) {
-            for (int b = 0; b < 3; b++) {
-                Map *map = item->light_maps[a][b];
-                if (map && map->size) {
-                    has_light = 1;
-                }
-            }
+int take_page(int rp, int rq, int size, int *offset) {
+    // chunks of one region share pages, so they also share an origin
+    int empty = -1;
+    for (int i = 0; i < MAX_PAGES; i++) {
+        Page *page = g->pages + i;
+        if (!page->buffer) {
+            empty = empty < 0 ? i : empty;
+            continue;
         }
-    }
-
-    // populate opaque array
-    for (int a = 0; a < 3; a++) {
-        for (int b = 0; b < 3; b++) {
-            Map *map = item->block_maps[a][b];
-            if (!map) {
-                continue;
+        if (page->rp == rp && page->rq == rq) {
+            *offset = arena_take(&page->arena, size);
+            if (*offset >= 0) {
+                return i;
             }
-            MAP_FOR_EACH(map, ex, ey, ez, ew) {
-                int x = ex - ox;
-                int y = ey - oy;
-                int z = ez - oz;
-                int w = ew;
-                // TODO: this should be unnecessary
-                if (x < 0 || y < 0 || z < 0) {
-                    continue;
-                }
-                if (x >= XZ_SIZE || y >= Y_SIZE || z >= XZ_SIZE) {
-                    continue;
-                }
-                // END TODO
-                opaque[XYZ(x, y, z)] = !is_transparent(w);
-                if (opaque[XYZ(x, y, z)]) {
-                    highest[XZ(x, z)] = MAX(highest[XZ(x, z)], y);
-                }
-            } END_MAP_FOR_EACH;
         }
     }
-
-    // flood fill light intensities
-    if (has_light) {
-        for (int a = 0; a < 3; a++) {
-            for (int b = 0; b < 3; b++) {
-                Map *map = item->light_maps[a][b];
-                if (!map) {
-                    continue;
-                }
-                MAP_FOR_EACH(map, ex, ey, ez, ew) {
-                    int x = ex - ox;
-                    int y = ey - oy;
-                    int z = ez - oz;
-                    light_fill(opaque, light, x, y, z, ew, 1);
-                } END_MAP_FOR_EACH;
-            }
-        }
+    if (empty < 0) {
+        return -1;
     }
+    Page *page = g->pages + empty;
+    int stride = chunk_bytes(1) / FACE_VERTICES;
+    int capacity = MAX(PAGE_BYTES / stride, size);
+    page->rp = rp;
+    page->rq = rq;
+    glGenBuffers(1, &page->buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, page->buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * stride, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    arena_alloc(&page->arena, capacity);
+    *offset = arena_take(&page->arena, size);
+    return empty;
+}
 
-    Map *map = item->block_maps[1][1];
-
-    // count exposed faces
-    int miny = 256;
-    int maxy = 0;
-    int faces = 0;
-    MAP_FOR_EACH(map, ex, ey, ez, ew) {
-        if (ew <= 0) {
-            continue;
-        }
-        int x = ex - ox;
-        int y = ey - oy;
-        int z = ez - oz;
-        int f1 = !opaque[XYZ(x - 1, y, z)];
-        int f2 = !opaque[XYZ(x + 1, y, z)];
-        int f3 = !opaque[XYZ(x, y + 1, z)];
-        int f4 = !opaque[XYZ(x, y - 1, z)] && (ey > 0);
-        int f5 = !opaque[XYZ(x, y, z - 1)];
-        int f6 = !opaque[XYZ(x, y, z + 1)];
-        int total = f1 + f2 + f3 + f4 + f5 + f6;
-        if (total == 0) {
-            continue;
+void gen_section_arena(Chunk *chunk, Section *section, void *data) {
+    // a remesh that still fits its slot is written in place, anything
+    // else moves to a new slot with some room to grow
+    int size = section->faces * FACE_VERTICES;
+    int stride = chunk_bytes(1) / FACE_VERTICES;
+    if (section->page < 0 || size > section->capacity) {
+        release_section_buffer(section);
+        if (!size) {
+            return;
         }
-        if (is_plant(ew)) {
-            total = 4;
+        int capacity = size + size / 4;
+        section->page = take_page(mesh_region(chunk->p),
+            mesh_region(chunk->q), capacity, &section->offset);
+        section->capacity = capacity;
+        if (section->page < 0) {
+            return;
         }
-        miny = MIN(miny, ey);
-        maxy = MAX(maxy, ey);
-        faces += total;
-    } END_MAP_FOR_EACH;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, g->pages[section->page].buffer);
+    glBufferSubData(GL_ARRAY_BUFFER,
+        section->offset * stride, chunk_bytes(section->faces), data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    // generate geometry
-    GLfloat *data = malloc_faces(10, faces);
-    int offset = 0;
-    MAP_FOR_EACH(map, ex, ey, ez, ew) {
-        if (ew <= 0) {
+void generate_chunk(Chunk *chunk, WorkerItem *item) {
+    // only the sections in the mask were meshed, the rest keep what
+    // they had and the chunk bounds are summed up from all of them
+    MeshSections *table = (MeshSections *)item->data;
+    char *data = (char *)(table + 1);
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        Section *section = chunk->sections + i;
+        if (!(table->mask >> i & 1)) {
             continue;
         }
-        int x = ex - ox;
-        int y = ey - oy;
-        int z = ez - oz;
-        int f1 = !opaque[XYZ(x - 1, y, z)];
-        int f2 = !opaque[XYZ(x + 1, y, z)];
-        int f3 = !opaque[XYZ(x, y + 1, z)];
-        int f4 = !opaque[XYZ(x, y - 1, z)] && (ey > 0);
-        int f5 = !opaque[XYZ(x, y, z - 1)];
-        int f6 = !opaque[XYZ(x, y, z + 1)];
-        int total = f1 + f2 + f3 + f4 + f5 + f6;
-        if (total == 0) {
-            continue;
+        section->faces = table->faces[i];
+        section->miny = table->miny[i];
+        section->maxy = table->maxy[i];
+        section->connect = table->connect[i];
+        if (CHUNK_ARENA) {
+            gen_section_arena(chunk, section, data);
         }
-        char neighbors[27] = {0};
-        char lights[27] = {0};
-        float shades[27] = {0};
-        int index = 0;
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                for (int dz = -1; dz <= 1; dz++) {
-                    neighbors[index] = opaque[XYZ(x + dx, y + dy, z + dz)];
-                    lights[index] = light[XYZ(x + dx, y + dy, z + dz)];
-                    shades[index] = 0;
-                    if (y + dy <= highest[XZ(x + dx, z + dz)]) {
-                        for (int oy = 0; oy < 8; oy++) {
-                            if (opaque[XYZ(x + dx, y + dy + oy, z + dz)]) {
-                                shades[index] = 1.0 - oy * 0.125;
-                                break;
-                            }
-                        }
-                    }
-                    index++;
-                }
-            }
-        }
-        float ao[6][4];
-        float light[6][4];
-        occlusion(neighbors, lights, shades, ao, light);
-        if (is_plant(ew)) {
-            total = 4;
-            float min_ao = 1;
-            float max_light = 0;
-            for (int a = 0; a < 6; a++) {
-                for (int b = 0; b < 4; b++) {
-                    min_ao = MIN(min_ao, ao[a][b]);
-                    max_light = MAX(max_light, light[a][b]);
-                }
-            }
-            float rotation = simplex2(ex, ez, 4, 0.5, 2) * 360;
-            make_plant(
-                data + offset, min_ao, max_light,
-                ex, ey, ez, 0.5, ew, rotation);
-        }
-        else {
-            make_cube(
-                data + offset, ao, light,
-                f1, f2, f3, f4, f5, f6,
-                ex, ey, ez, 0.5, ew);
-        }
-        offset += total * 60;
-    } END_MAP_FOR_EACH;
-
-    free(opaque);
-    free(light);
-    free(highest);
-
-    item->miny = miny;
-    item->maxy = maxy;
-    item->faces = faces;
-    item->data = data;
-}
-
-void generate_chunk(Chunk *chunk, WorkerItem *item) {
-    chunk->miny = item->miny;
-    chunk->maxy = item->maxy;
-    chunk->faces = item->faces;
-    del_buffer(chunk->buffer);
-    chunk->buffer = gen_faces(10, item->faces, item->data);
+        data += chunk_bytes(section->faces);
+    }
+    chunk->faces = 0;
+    chunk->miny = 256;
+    chunk->maxy = 0;
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        Section *section = chunk->sections + i;
+        chunk->faces += section->faces;
+        chunk->miny = MIN(chunk->miny, section->miny);
+        chunk->maxy = MAX(chunk->maxy, section->maxy);
+    }
+    chunk->cached = item->hit.base != 0;
+    chunk->partial = !item->complete;
+    chunk->meshed = 1;
+    if (!CHUNK_ARENA) {
+        del_buffer(chunk->buffer);
+        chunk->buffer = gen_buffer(
+            chunk_bytes(item->faces), (GLfloat *)(table + 1));
+    }
+    free_item_data(item, &g->pool);
+    if (INDEXED_QUADS) {
+        ensure_index_buffer(chunk->faces);
+    }
     gen_sign_buffer(chunk);
 }
 
@@ -1147,6 +1348,11 @@ void gen_chunk_buffer(Chunk *chunk) {
     WorkerItem *item = &_item;
     item->p = chunk->p;
     item->q = chunk->q;
+    item->greedy = GREEDY_MESHING;
+    item->simd = SIMD_OCCLUSION;
+    item->sections = take_sections(chunk);
+    item->complete = chunk->lit && chunk_complete(chunk);
+    item->hit.base = 0;
     for (int dp = -1; dp <= 1; dp++) {
         for (int dq = -1; dq <= 1; dq++) {
             Chunk *other = chunk;
@@ -1156,31 +1362,270 @@ void gen_chunk_buffer(Chunk *chunk) {
             if (other) {
                 item->block_maps[dp + 1][dq + 1] = &other->map;
                 item->light_maps[dp + 1][dq + 1] = &other->lights;
+                item->dense_maps[dp + 1][dq + 1] =
+                    DENSE_STORAGE ? &other->dense : 0;
+                item->light_fields[dp + 1][dq + 1] = &other->light_field;
             }
             else {
                 item->block_maps[dp + 1][dq + 1] = 0;
                 item->light_maps[dp + 1][dq + 1] = 0;
+                item->dense_maps[dp + 1][dq + 1] = 0;
+                item->light_fields[dp + 1][dq + 1] = 0;
             }
         }
     }
-    compute_chunk(item);
+    compute_chunk(item, &g->scratch);
     generate_chunk(chunk, item);
-    chunk->dirty = 0;
 }
 
-void map_set_func(int x, int y, int z, int w, void *arg) {
-    Map *map = (Map *)arg;
-    map_set(map, x, y, z, w);
+void light_push(LightQueue *queue, int x, int y, int z, int w) {
+    if (queue->size == queue->capacity) {
+        // compact the consumed head before growing
+        if (queue->head) {
+            queue->size -= queue->head;
+            memmove(queue->data, queue->data + queue->head,
+                sizeof(Block) * queue->size);
+            queue->head = 0;
+        }
+        if (queue->size == queue->capacity) {
+            queue->capacity = MAX(queue->capacity * 2, 256);
+            queue->data = (Block *)realloc(
+                queue->data, sizeof(Block) * queue->capacity);
+        }
+    }
+    Block *node = queue->data + queue->size++;
+    node->x = x; node->y = y; node->z = z; node->w = w;
+}
+
+int light_pop(LightQueue *queue, Block *node) {
+    if (queue->head == queue->size) {
+        return 0;
+    }
+    *node = queue->data[queue->head++];
+    return 1;
+}
+
+Chunk *light_chunk(int x, int z) {
+    Chunk *chunk = find_chunk(chunked(x), chunked(z));
+    return chunk && chunk->lit ? chunk : 0;
+}
+
+int light_get(int x, int y, int z) {
+    Chunk *chunk = light_chunk(x, z);
+    return chunk ? dense_get(&chunk->light_field, x, y, z) : 0;
+}
+
+int light_source(int x, int y, int z) {
+    Chunk *chunk = light_chunk(x, z);
+    return chunk ? map_get(&chunk->lights, x, y, z) : 0;
+}
+
+void light_put(Chunk *chunk, int x, int y, int z, int w) {
+    if (!dense_set(&chunk->light_field, x, y, z, w)) {
+        return;
+    }
+    // meshes read light one block past their edge
+    dirty_height(chunk, y);
+    int lx = x - chunk->p * CHUNK_SIZE;
+    int lz = z - chunk->q * CHUNK_SIZE;
+    int dp = lx == 0 ? -1 : (lx == CHUNK_SIZE - 1 ? 1 : 0);
+    int dq = lz == 0 ? -1 : (lz == CHUNK_SIZE - 1 ? 1 : 0);
+    for (int a = 0; a <= ABS(dp); a++) {
+        for (int b = 0; b <= ABS(dq); b++) {
+            Chunk *other = find_chunk(chunk->p + a * dp, chunk->q + b * dq);
+            if (other && other != chunk) {
+                dirty_height(other, y);
+            }
+        }
+    }
+}
+
+static const int light_offsets[6][3] = {
+    {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}
+};
+
+void light_spread(LightQueue *queue) {
+    // breadth first from every queued voxel at its current level
+    Block node;
+    while (light_pop(queue, &node)) {
+        int w = light_get(node.x, node.y, node.z) - 1;
+        if (w <= 0) {
+            continue;
+        }
+        for (int i = 0; i < 6; i++) {
+            int x = node.x + light_offsets[i][0];
+            int y = node.y + light_offsets[i][1];
+            int z = node.z + light_offsets[i][2];
+            if (y < 0 || y >= 256) {
+                continue;
+            }
+            Chunk *chunk = light_chunk(x, z);
+            if (!chunk || !is_transparent(chunk_get(chunk, x, y, z))) {
+                continue;
+            }
+            if (dense_get(&chunk->light_field, x, y, z) >= w) {
+                continue;
+            }
+            light_put(chunk, x, y, z, w);
+            light_push(queue, x, y, z, w);
+        }
+    }
+}
+
+void light_add(int x, int y, int z, int w) {
+    Chunk *chunk = light_chunk(x, z);
+    if (!chunk || dense_get(&chunk->light_field, x, y, z) >= w) {
+        return;
+    }
+    LightQueue queue = {0};
+    light_put(chunk, x, y, z, w);
+    light_push(&queue, x, y, z, w);
+    light_spread(&queue);
+    free(queue.data);
+}
+
+void light_remove(int x, int y, int z) {
+    // floods out everything that got its level through (x, y, z), then
+    // refills from the brighter voxels around the hole and from any
+    // sources that were cleared on the way
+    Chunk *chunk = light_chunk(x, z);
+    int w = chunk ? dense_get(&chunk->light_field, x, y, z) : 0;
+    if (!w) {
+        return;
+    }
+    LightQueue removed = {0};
+    LightQueue sources = {0};
+    LightQueue refill = {0};
+    light_put(chunk, x, y, z, 0);
+    light_push(&removed, x, y, z, w);
+    light_push(&sources, x, y, z, 0);
+    Block node;
+    while (light_pop(&removed, &node)) {
+        for (int i = 0; i < 6; i++) {
+            int nx = node.x + light_offsets[i][0];
+            int ny = node.y + light_offsets[i][1];
+            int nz = node.z + light_offsets[i][2];
+            if (ny < 0 || ny >= 256) {
+                continue;
+            }
+            Chunk *other = light_chunk(nx, nz);
+            if (!other) {
+                continue;
+            }
+            int nw = dense_get(&other->light_field, nx, ny, nz);
+            if (!nw) {
+                continue;
+            }
+            if (nw < node.w) {
+                light_put(other, nx, ny, nz, 0);
+                light_push(&removed, nx, ny, nz, nw);
+                light_push(&sources, nx, ny, nz, 0);
+            }
+            else {
+                light_push(&refill, nx, ny, nz, nw);
+            }
+        }
+    }
+    while (light_pop(&sources, &node)) {
+        int source = light_source(node.x, node.y, node.z);
+        Chunk *other = light_chunk(node.x, node.z);
+        if (source > dense_get(&other->light_field, node.x, node.y, node.z)) {
+            light_put(other, node.x, node.y, node.z, source);
+            light_push(&refill, node.x, node.y, node.z, source);
+        }
+    }
+    light_spread(&refill);
+    free(removed.data);
+    free(sources.data);
+    free(refill.data);
+}
+
+void light_update(int x, int y, int z) {
+    // the light source at (x, y, z) changed
+    if (!SHOW_LIGHTS) {
+        return;
+    }
+    light_remove(x, y, z);
+    int w = light_source(x, y, z);
+    if (w) {
+        light_add(x, y, z, w);
+    }
 }
 
-void load_chunk(WorkerItem *item) {
-    int p = item->p;
-    int q = item->q;
-    Map *block_map = item->block_maps[1][1];
-    Map *light_map = item->light_maps[1][1];
-    create_world(p, q, map_set_func, block_map);
-    db_load_blocks(block_map, p, q);
-    db_load_lights(light_map, p, q);
+void light_block(int x, int y, int z, int w) {
+    // the block at (x, y, z) changed to w
+    if (!SHOW_LIGHTS || light_source(x, y, z)) {
+        return;
+    }
+    if (!is_transparent(w)) {
+        light_remove(x, y, z);
+        return;
+    }
+    LightQueue queue = {0};
+    for (int i = 0; i < 6; i++) {
+        light_push(&queue,
+            x + light_offsets[i][0],
+            y + light_offsets[i][1],
+            z + light_offsets[i][2], 0);
+    }
+    light_spread(&queue);
+    free(queue.data);
+}
+
+void light_load(Chunk *chunk) {
+    // lights a chunk whose blocks just arrived, from its own sources and
+    // from whatever its neighbors already spread up to its edges
+    chunk->lit = 1;
+    if (!SHOW_LIGHTS) {
+        return;
+    }
+    // meshes that came from the cache were built with this light already
+    Chunk *cached[9];
+    int count = 0;
+    for (int dp = -1; dp <= 1; dp++) {
+        for (int dq = -1; dq <= 1; dq++) {
+            Chunk *other = find_chunk(chunk->p + dp, chunk->q + dq);
+            if (other && other->cached && !other->dirty) {
+                cached[count++] = other;
+            }
+        }
+    }
+    LightQueue queue = {0};
+    Map *map = &chunk->lights;
+    MAP_FOR_EACH(map, ex, ey, ez, ew) {
+        if (chunked(ex) != chunk->p || chunked(ez) != chunk->q) {
+            continue;
+        }
+        if (ew > dense_get(&chunk->light_field, ex, ey, ez)) {
+            light_put(chunk, ex, ey, ez, ew);
+            light_push(&queue, ex, ey, ez, ew);
+        }
+    } END_MAP_FOR_EACH;
+    int x1 = chunk->p * CHUNK_SIZE;
+    int z1 = chunk->q * CHUNK_SIZE;
+    int x2 = x1 + CHUNK_SIZE - 1;
+    int z2 = z1 + CHUNK_SIZE - 1;
+    for (int y = 0; y < 256; y++) {
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            int edges[4][2] = {
+                {x1 - 1, z1 + i}, {x2 + 1, z1 + i},
+                {x1 + i, z1 - 1}, {x1 + i, z2 + 1}
+            };
+            for (int j = 0; j < 4; j++) {
+                int x = edges[j][0];
+                int z = edges[j][1];
+                if (light_get(x, y, z) > 1) {
+                    light_push(&queue, x, y, z, 0);
+                }
+            }
+        }
+    }
+    light_spread(&queue);
+    free(queue.data);
+    for (int i = 0; i < count; i++) {
+        cached[i]->dirty = 0;
+        cached[i]->dirty_sections = 0;
+    }
 }
 
 void request_chunk(int p, int q) {
@@ -1191,10 +1636,26 @@ void request_chunk(int p, int q) {
 void init_chunk(Chunk *chunk, int p, int q) {
     chunk->p = p;
     chunk->q = q;
+    table_set(&g->chunk_table, p, q, chunk);
     chunk->faces = 0;
     chunk->sign_faces = 0;
+    chunk->meshed = 0;
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        Section *section = chunk->sections + i;
+        section->faces = 0;
+        section->miny = 256;
+        section->maxy = 0;
+        section->page = -1;
+        section->connect = SECTION_OPEN;
+        section->visited = 0;
+    }
     chunk->buffer = 0;
     chunk->sign_buffer = 0;
+    chunk->busy = 0;
+    chunk->lit = 0;
+    chunk->cached = 0;
+    chunk->partial = 0;
+    chunk->requested = glfwGetTime();
     dirty_chunk(chunk);
     SignList *signs = &chunk->signs;
     sign_list_alloc(signs, 16);
@@ -1206,6 +1667,9 @@ void init_chunk(Chunk *chunk, int p, int q) {
     int dz = q * CHUNK_SIZE - 1;
     map_alloc(block_map, dx, dy, dz, 0x7fff);
     map_alloc(light_map, dx, dy, dz, 0xf);
+    dense_alloc(&chunk->dense, dx, dz);
+    dense_alloc(&chunk->light_field, dx, dz);
+    compute_heights(chunk);
 }
 
 void create_chunk(Chunk *chunk, int p, int q) {
@@ -1217,7 +1681,11 @@ void create_chunk(Chunk *chunk, int p, int q) {
     item->q = chunk->q;
     item->block_maps[1][1] = &chunk->map;
     item->light_maps[1][1] = &chunk->lights;
-    load_chunk(item);
+    item->dense_maps[1][1] = DENSE_STORAGE ? &chunk->dense : 0;
+    item->commit = -1;
+    load_chunk(item, g->worker_count);
+    compute_heights(chunk);
+    light_load(chunk);
 
     request_chunk(p, q);
 }
@@ -1243,13 +1711,24 @@ void delete_chunks() {
         if (delete) {
             map_free(&chunk->map);
             map_free(&chunk->lights);
+            dense_free(&chunk->dense);
+            dense_free(&chunk->light_field);
             sign_list_free(&chunk->signs);
-            del_buffer(chunk->buffer);
+            release_chunk_buffer(chunk);
             del_buffer(chunk->sign_buffer);
+            table_remove(&g->chunk_table, chunk->p, chunk->q);
             Chunk *other = g->chunks + (--count);
-            memcpy(chunk, other, sizeof(Chunk));
+            if (other != chunk) {
+                memcpy(chunk, other, sizeof(Chunk));
+                table_set(&g->chunk_table, chunk->p, chunk->q, chunk);
+            }
         }
     }
+    if (count < g->chunk_count) {
+        // loads read through other connections and only see committed
+        // rows, so edits to chunks leaving range are committed right away
+        db_commit();
+    }
     g->chunk_count = count;
 }
 
@@ -1258,49 +1737,155 @@ void delete_all_chunks() {
         Chunk *chunk = g->chunks + i;
         map_free(&chunk->map);
         map_free(&chunk->lights);
+        dense_free(&chunk->dense);
+        dense_free(&chunk->light_field);
         sign_list_free(&chunk->signs);
-        del_buffer(chunk->buffer);
+        release_chunk_buffer(chunk);
         del_buffer(chunk->sign_buffer);
     }
     g->chunk_count = 0;
+    table_clear(&g->chunk_table);
+}
+
+Lod *find_lod(int level, int p, int q) {
+    return (Lod *)table_get(&g->lod_tables[level], p, q);
+}
+
+void delete_lod(Lod *lod) {
+    del_buffer(lod->buffer);
+    table_remove(&g->lod_tables[lod->level], lod->p, lod->q);
+    Lod *other = g->lods + (--g->lod_count);
+    if (other != lod) {
+        memcpy(lod, other, sizeof(Lod));
+        table_set(&g->lod_tables[lod->level], lod->p, lod->q, lod);
+    }
+}
+
+void delete_lods() {
+    // tiles no view asked for since the last call go, unless a worker is
+    // still building one, which is dropped once it comes back unused
+    for (int i = g->lod_count - 1; i >= 0; i--) {
+        Lod *lod = g->lods + i;
+        if (lod->frame != g->lod_frame && !lod->busy) {
+            delete_lod(lod);
+        }
+    }
+    g->lod_frame++;
+}
+
+void delete_all_lods() {
+    for (int i = 0; i < g->lod_count; i++) {
+        del_buffer(g->lods[i].buffer);
+    }
+    g->lod_count = 0;
+    for (int i = 0; i <= LOD_LEVELS; i++) {
+        table_clear(&g->lod_tables[i]);
+    }
+}
+
+void generate_lod(WorkerItem *item) {
+    Lod *lod = find_lod(item->lod, item->p, item->q);
+    if (lod) {
+        lod->busy = 0;
+        lod->faces = item->faces;
+        lod->maxy = item->maxy;
+        del_buffer(lod->buffer);
+        lod->buffer = gen_buffer(chunk_bytes(item->faces), item->data);
+        if (INDEXED_QUADS) {
+            ensure_index_buffer(item->faces);
+        }
+    }
+    free_item_data(item, &g->pool);
+}
+
+void remesh_partial(Chunk *chunk) {
+    // chunks meshed before all of their neighbors arrived are meshed once
+    // more when the last one does, so that a complete mesh gets cached
+    if (!get_cache_enabled()) {
+        return;
+    }
+    for (int dp = -1; dp <= 1; dp++) {
+        for (int dq = -1; dq <= 1; dq++) {
+            Chunk *other = find_chunk(chunk->p + dp, chunk->q + dq);
+            if (other && other->partial && other->lit &&
+                chunk_complete(other))
+            {
+                other->partial = 0;
+                dirty_chunk(other);
+            }
+        }
+    }
 }
 
 void check_workers() {
-    for (int i = 0; i < WORKERS; i++) {
-        Worker *worker = g->workers + i;
-        mtx_lock(&worker->mtx);
-        if (worker->state == WORKER_DONE) {
-            WorkerItem *item = &worker->item;
-            Chunk *chunk = find_chunk(item->p, item->q);
-            if (chunk) {
-                if (item->load) {
-                    Map *block_map = item->block_maps[1][1];
-                    Map *light_map = item->light_maps[1][1];
-                    map_free(&chunk->map);
-                    map_free(&chunk->lights);
-                    map_copy(&chunk->map, block_map);
-                    map_copy(&chunk->lights, light_map);
-                    request_chunk(item->p, item->q);
+    void *data;
+    while (queue_pop(&g->done, &data)) {
+        WorkerItem *item = (WorkerItem *)data;
+        g->job_count--;
+        g->job_allocs = item->allocs;
+        if (item->lod) {
+            generate_lod(item);
+            free(item);
+            continue;
+        }
+        Chunk *chunk = find_chunk(item->p, item->q);
+        if (chunk) {
+            chunk->busy = 0;
+            if (item->load) {
+                Map *block_map = item->block_maps[1][1];
+                Map *light_map = item->light_maps[1][1];
+                map_free(&chunk->map);
+                map_free(&chunk->lights);
+                memcpy(&chunk->map, block_map, sizeof(Map));
+                memcpy(&chunk->lights, light_map, sizeof(Map));
+                free(block_map);
+                free(light_map);
+                item->block_maps[1][1] = 0;
+                item->light_maps[1][1] = 0;
+                Dense *dense = item->dense_maps[1][1];
+                if (dense) {
+                    dense_free(&chunk->dense);
+                    memcpy(&chunk->dense, dense, sizeof(Dense));
+                    free(dense);
+                    item->dense_maps[1][1] = 0;
                 }
-                generate_chunk(chunk, item);
-            }
-            for (int a = 0; a < 3; a++) {
-                for (int b = 0; b < 3; b++) {
-                    Map *block_map = item->block_maps[a][b];
-                    Map *light_map = item->light_maps[a][b];
-                    if (block_map) {
-                        map_free(block_map);
-                        free(block_map);
-                    }
-                    if (light_map) {
-                        map_free(light_map);
-                        free(light_map);
-                    }
+                compute_heights(chunk);
+                request_chunk(item->p, item->q);
+            }
+            generate_chunk(chunk, item);
+            if (item->load) {
+                light_load(chunk);
+                remesh_partial(chunk);
+            }
+        }
+        else {
+            free_item_data(item, &g->pool);
+        }
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) {
+                Map *block_map = item->block_maps[a][b];
+                Map *light_map = item->light_maps[a][b];
+                Dense *dense = item->dense_maps[a][b];
+                Dense *light_field = item->light_fields[a][b];
+                if (block_map) {
+                    map_free(block_map);
+                    free(block_map);
+                }
+                if (light_map) {
+                    map_free(light_map);
+                    free(light_map);
+                }
+                if (dense) {
+                    dense_free(dense);
+                    free(dense);
+                }
+                if (light_field) {
+                    dense_free(light_field);
+                    free(light_field);
                 }
             }
-            worker->state = WORKER_IDLE;
         }
-        mtx_unlock(&worker->mtx);
+        free(item);
     }
 }
 
@@ -1328,7 +1913,30 @@ void force_chunks(Player *player) {
     }
 }
 
-void ensure_chunks_worker(Player *player, Worker *worker) {
+typedef struct {
+    int score;
+    int p;
+    int q;
+} Candidate;
+
+int candidate_compare(const void *a, const void *b) {
+    return ((const Candidate *)a)->score - ((const Candidate *)b)->score;
+}
+
+void submit_job(WorkerItem *item, int score) {
+    Worker *worker = g->workers + g->job_next;
+    g->job_next = (g->job_next + 1) % g->worker_count;
+    mtx_lock(&worker->mtx);
+    heap_push(&worker->jobs, score, item);
+    mtx_unlock(&worker->mtx);
+    g->job_count++;
+    mtx_lock(&g->job_mtx);
+    g->job_pending++;
+    cnd_signal(&g->job_cnd);
+    mtx_unlock(&g->job_mtx);
+}
+
+void ensure_chunks_worker(Player *player, int capacity) {
     State *s = &player->state;
     float matrix[16];
     set_matrix_3d(
@@ -1339,112 +1947,175 @@ void ensure_chunks_worker(Player *player, Worker *worker) {
     int p = chunked(s->x);
     int q = chunked(s->z);
     int r = g->create_radius;
-    int start = 0x0fffffff;
-    int best_score = start;
-    int best_a = 0;
-    int best_b = 0;
+    int size = r * 2 + 1;
+    Candidate *candidates = malloc(sizeof(Candidate) * size * size);
+    int count = 0;
     for (int dp = -r; dp <= r; dp++) {
         for (int dq = -r; dq <= r; dq++) {
             int a = p + dp;
             int b = q + dq;
-            int index = (ABS(a) ^ ABS(b)) % WORKERS;
-            if (index != worker->index) {
-                continue;
-            }
             Chunk *chunk = find_chunk(a, b);
-            if (chunk && !chunk->dirty) {
+            if (chunk && (!chunk->dirty || chunk->busy)) {
                 continue;
             }
             int distance = MAX(ABS(dp), ABS(dq));
             int invisible = !chunk_visible(planes, a, b, 0, 256);
             int priority = 0;
             if (chunk) {
-                priority = chunk->buffer && chunk->dirty;
+                priority = chunk->meshed && chunk->dirty;
             }
-            int score = (invisible << 24) | (priority << 16) | distance;
-            if (score < best_score) {
-                best_score = score;
-                best_a = a;
-                best_b = b;
-            }
-        }
-    }
-    if (best_score == start) {
-        return;
-    }
-    int a = best_a;
-    int b = best_b;
-    int load = 0;
-    Chunk *chunk = find_chunk(a, b);
-    if (!chunk) {
-        load = 1;
-        if (g->chunk_count < MAX_CHUNKS) {
-            chunk = g->chunks + g->chunk_count++;
-            init_chunk(chunk, a, b);
-        }
-        else {
-            return;
+            Candidate *candidate = candidates + count++;
+            candidate->score = (invisible << 24) | (priority << 16) | distance;
+            candidate->p = a;
+            candidate->q = b;
         }
     }
-    WorkerItem *item = &worker->item;
-    item->p = chunk->p;
-    item->q = chunk->q;
-    item->load = load;
-    for (int dp = -1; dp <= 1; dp++) {
-        for (int dq = -1; dq <= 1; dq++) {
-            Chunk *other = chunk;
-            if (dp || dq) {
-                other = find_chunk(chunk->p + dp, chunk->q + dq);
-            }
-            if (other) {
-                Map *block_map = malloc(sizeof(Map));
-                map_copy(block_map, &other->map);
-                Map *light_map = malloc(sizeof(Map));
-                map_copy(light_map, &other->lights);
-                item->block_maps[dp + 1][dq + 1] = block_map;
-                item->light_maps[dp + 1][dq + 1] = light_map;
+    qsort(candidates, count, sizeof(Candidate), candidate_compare);
+    count = MIN(count, capacity);
+    for (int i = 0; i < count; i++) {
+        Candidate *candidate = candidates + i;
+        int load = 0;
+        Chunk *chunk = find_chunk(candidate->p, candidate->q);
+        if (!chunk) {
+            load = 1;
+            if (g->chunk_count < MAX_CHUNKS) {
+                chunk = g->chunks + g->chunk_count++;
+                init_chunk(chunk, candidate->p, candidate->q);
             }
             else {
-                item->block_maps[dp + 1][dq + 1] = 0;
-                item->light_maps[dp + 1][dq + 1] = 0;
+                break;
             }
         }
+        WorkerItem *item = malloc(sizeof(WorkerItem));
+        item->p = chunk->p;
+        item->q = chunk->q;
+        item->load = load;
+        item->greedy = GREEDY_MESHING;
+        item->simd = SIMD_OCCLUSION;
+        item->sections = take_sections(chunk);
+        item->complete = (load || chunk->lit) && chunk_complete(chunk);
+        item->commit = db_snapshot();
+        item->hashed = 0;
+        for (int dp = -1; dp <= 1; dp++) {
+            for (int dq = -1; dq <= 1; dq++) {
+                Chunk *other = chunk;
+                if (dp || dq) {
+                    other = find_chunk(chunk->p + dp, chunk->q + dq);
+                }
+                if (other == chunk && load) {
+                    // the worker fills these in, so start from empty maps
+                    // rather than sharing the placeholders init_chunk made
+                    Map *block_map = malloc(sizeof(Map));
+                    Map *light_map = malloc(sizeof(Map));
+                    Map *a = &other->map;
+                    Map *b = &other->lights;
+                    map_alloc(block_map, a->dx, a->dy, a->dz, a->mask);
+                    map_alloc(light_map, b->dx, b->dy, b->dz, b->mask);
+                    item->block_maps[1][1] = block_map;
+                    item->light_maps[1][1] = light_map;
+                    item->dense_maps[1][1] = 0;
+                    item->light_fields[1][1] = 0;
+                    if (DENSE_STORAGE) {
+                        Dense *dense = malloc(sizeof(Dense));
+                        dense_alloc(dense, a->dx, a->dz);
+                        item->dense_maps[1][1] = dense;
+                    }
+                }
+                else if (other) {
+                    Map *block_map = malloc(sizeof(Map));
+                    map_snapshot(block_map, &other->map);
+                    Dense *light_field = malloc(sizeof(Dense));
+                    dense_snapshot(light_field, &other->light_field);
+                    item->block_maps[dp + 1][dq + 1] = block_map;
+                    item->light_maps[dp + 1][dq + 1] = 0;
+                    item->light_fields[dp + 1][dq + 1] = light_field;
+                    item->dense_maps[dp + 1][dq + 1] = 0;
+                    if (DENSE_STORAGE) {
+                        Dense *dense = malloc(sizeof(Dense));
+                        dense_snapshot(dense, &other->dense);
+                        item->dense_maps[dp + 1][dq + 1] = dense;
+                    }
+                }
+                else {
+                    item->block_maps[dp + 1][dq + 1] = 0;
+                    item->light_maps[dp + 1][dq + 1] = 0;
+                    item->dense_maps[dp + 1][dq + 1] = 0;
+                    item->light_fields[dp + 1][dq + 1] = 0;
+                }
+            }
+        }
+        chunk->busy = 1;
+        submit_job(item, candidate->score);
     }
-    chunk->dirty = 0;
-    worker->state = WORKER_BUSY;
-    cnd_signal(&worker->cnd);
+    free(candidates);
 }
 
 void ensure_chunks(Player *player) {
     check_workers();
     force_chunks(player);
-    for (int i = 0; i < WORKERS; i++) {
-        Worker *worker = g->workers + i;
-        mtx_lock(&worker->mtx);
-        if (worker->state == WORKER_IDLE) {
-            ensure_chunks_worker(player, worker);
-        }
-        mtx_unlock(&worker->mtx);
+    int capacity = g->worker_count * JOBS_PER_WORKER - g->job_count;
+    if (capacity > 0) {
+        ensure_chunks_worker(player, capacity);
+    }
+}
+
+WorkerItem *take_job(Worker *worker) {
+    // the best job queued anywhere, ties going to our own queue; if
+    // another worker empties that queue first the caller simply retries
+    Worker *best = 0;
+    int best_score = 0;
+    for (int i = 0; i < g->worker_count; i++) {
+        Worker *other = g->workers + (worker->index + i) % g->worker_count;
+        int score;
+        mtx_lock(&other->mtx);
+        int found = heap_peek(&other->jobs, &score);
+        mtx_unlock(&other->mtx);
+        if (found && (!best || score < best_score)) {
+            best = other;
+            best_score = score;
+        }
+    }
+    if (!best) {
+        return 0;
     }
+    void *data;
+    mtx_lock(&best->mtx);
+    int found = heap_pop(&best->jobs, 0, &data);
+    mtx_unlock(&best->mtx);
+    return found ? (WorkerItem *)data : 0;
 }
 
 int worker_run(void *arg) {
     Worker *worker = (Worker *)arg;
     int running = 1;
     while (running) {
-        mtx_lock(&worker->mtx);
-        while (worker->state != WORKER_BUSY) {
-            cnd_wait(&worker->cnd, &worker->mtx);
+        mtx_lock(&g->job_mtx);
+        while (g->job_pending == 0) {
+            cnd_wait(&g->job_cnd, &g->job_mtx);
         }
-        mtx_unlock(&worker->mtx);
-        WorkerItem *item = &worker->item;
-        if (item->load) {
-            load_chunk(item);
+        g->job_pending--;
+        mtx_unlock(&g->job_mtx);
+        WorkerItem *item;
+        while (!(item = take_job(worker))) {
+            thrd_yield();
+        }
+        // each worker reads through its own connection
+        double start = glfwGetTime();
+        if (item->lod) {
+            mesh_lod(item, &worker->scratch, worker->index);
+        }
+        else {
+            if (item->load) {
+                load_chunk(item, worker->index);
+            }
+            mesh_chunk(item, &worker->scratch, worker->index);
         }
-        compute_chunk(item);
         mtx_lock(&worker->mtx);
-        worker->state = WORKER_DONE;
+        worker->busy += glfwGetTime() - start;
         mtx_unlock(&worker->mtx);
+        while (!queue_push(&g->done, item)) {
+            thrd_yield();
+        }
     }
     return 0;
 }
@@ -1516,7 +2187,7 @@ void toggle_light(int x, int y, int z) {
         map_set(map, x, y, z, w);
         db_insert_light(p, q, x, y, z, w);
         client_light(x, y, z, w);
-        dirty_chunk(chunk);
+        light_update(x, y, z);
     }
 }
 
@@ -1525,7 +2196,7 @@ void set_light(int p, int q, int x, int y, int z, int w) {
     if (chunk) {
         Map *map = &chunk->lights;
         if (map_set(map, x, y, z, w)) {
-            dirty_chunk(chunk);
+            light_update(x, y, z);
             db_insert_light(p, q, x, y, z, w);
         }
     }
@@ -1534,30 +2205,124 @@ void set_light(int p, int q, int x, int y, int z, int w) {
     }
 }
 
-void _set_block(int p, int q, int x, int y, int z, int w, int dirty) {
+void set_blocks(int p, int q, EditList *list, int dirty) {
+    // any number of blocks stored in chunk (p, q), found once and saved
+    // as one batch
     Chunk *chunk = find_chunk(p, q);
-    if (chunk) {
-        Map *map = &chunk->map;
-        if (map_set(map, x, y, z, w)) {
-            if (dirty) {
-                dirty_chunk(chunk);
+    EditList *changed = &g->changed;
+    changed->size = 0;
+    for (unsigned int i = 0; i < list->size; i++) {
+        int x = list->data[i].x;
+        int y = list->data[i].y;
+        int z = list->data[i].z;
+        int w = list->data[i].w;
+        if (chunk) {
+            Map *map = &chunk->map;
+            int previous = map_get(map, x, y, z);
+            if (map_set(map, x, y, z, w)) {
+                if (DENSE_STORAGE) {
+                    dense_set(&chunk->dense, x, y, z, w);
+                }
+                update_height(chunk, x, y, z, w);
+                if (chunk->lit && chunked(x) == p && chunked(z) == q &&
+                    is_transparent(previous) != is_transparent(w))
+                {
+                    light_block(x, y, z, w);
+                }
+                if (dirty) {
+                    dirty_height(chunk, y);
+                }
+                edit_list_add(changed, x, y, z, w);
             }
-            db_insert_block(p, q, x, y, z, w);
+        }
+        else {
+            edit_list_add(changed, x, y, z, w);
+        }
+        if (w == 0 && chunked(x) == p && chunked(z) == q) {
+            unset_sign(x, y, z);
+            set_light(p, q, x, y, z, 0);
         }
     }
-    else {
-        db_insert_block(p, q, x, y, z, w);
+    db_insert_edits(p, q, changed);
+}
+
+void _set_block(int p, int q, int x, int y, int z, int w, int dirty) {
+    Edit edit = {x, y, z, w, 0};
+    EditList list = {1, 1, &edit};
+    set_blocks(p, q, &list, dirty);
+}
+
+void edit_add(int p, int q, int x, int y, int z, int w) {
+    EditList *list = (EditList *)table_get(&g->edit_table, p, q);
+    if (!list) {
+        list = (EditList *)malloc(sizeof(EditList));
+        edit_list_alloc(list, 256);
+        table_set(&g->edit_table, p, q, list);
     }
-    if (w == 0 && chunked(x) == p && chunked(z) == q) {
-        unset_sign(x, y, z);
-        set_light(p, q, x, y, z, 0);
+    edit_list_add(list, x, y, z, w);
+}
+
+void edit_begin() {
+    // until the matching edit_commit, set_block only records its writes
+    g->editing++;
+}
+
+void edit_commit() {
+    // applies the recorded writes one chunk at a time, dirtying each
+    // chunk once, then sends them to the server as runs along z
+    if (--g->editing) {
+        return;
+    }
+    Table *table = &g->edit_table;
+    for (unsigned int i = 0; i <= table->mask; i++) {
+        TableEntry *entry = table->data + i;
+        if (EMPTY_SLOT(entry)) {
+            continue;
+        }
+        EditList *list = (EditList *)entry->value;
+        edit_list_merge(list);
+        set_blocks(entry->p, entry->q, list, 1);
+        edit_list_free(list);
+        free(list);
+    }
+    table_clear(table);
+    EditList *blocks = &g->edit_blocks;
+    edit_list_merge(blocks);
+    for (unsigned int i = 0; i < blocks->size; ) {
+        Edit *e = blocks->data + i;
+        unsigned int n = 1;
+        while (i + n < blocks->size && n < CHUNK_SIZE * 8) {
+            Edit *next = e + n;
+            if (next->x != e->x || next->y != e->y ||
+                next->z != e->z + (int)n || next->w != e->w)
+            {
+                break;
+            }
+            n++;
+        }
+        // the server clears what is in the way, as builder_block does
+        client_region(e->x, e->y, e->z, e->w, n);
+        i += n;
     }
+    blocks->size = 0;
 }
 
 void set_block(int x, int y, int z, int w) {
     int p = chunked(x);
     int q = chunked(z);
-    _set_block(p, q, x, y, z, w, 1);
+    if (g->editing) {
+        // a cleared block drops its signs and light right away, since
+        // only the last write to each position is kept
+        edit_add(p, q, x, y, z, w);
+        edit_list_add(&g->edit_blocks, x, y, z, w);
+        if (w == 0) {
+            unset_sign(x, y, z);
+            set_light(p, q, x, y, z, 0);
+        }
+    }
+    else {
+        _set_block(p, q, x, y, z, w, 1);
+    }
     for (int dx = -1; dx <= 1; dx++) {
         for (int dz = -1; dz <= 1; dz++) {
             if (dx == 0 && dz == 0) {
@@ -1569,10 +2334,17 @@ void set_block(int x, int y, int z, int w) {
             if (dz && chunked(z + dz) == q) {
                 continue;
             }
-            _set_block(p + dx, q + dz, x, y, z, -w, 1);
+            if (g->editing) {
+                edit_add(p + dx, q + dz, x, y, z, -w);
+            }
+            else {
+                _set_block(p + dx, q + dz, x, y, z, -w, 1);
+            }
         }
     }
-    client_block(x, y, z, w);
+    if (!g->editing) {
+        client_block(x, y, z, w);
+    }
 }
 
 void record_block(int x, int y, int z, int w) {
@@ -1588,8 +2360,7 @@ int get_block(int x, int y, int z) {
     int q = chunked(z);
     Chunk *chunk = find_chunk(p, q);
     if (chunk) {
-        Map *map = &chunk->map;
-        return map_get(map, x, y, z);
+        return chunk_get(chunk, x, y, z);
     }
     return 0;
 }
@@ -1598,16 +2369,168 @@ void builder_block(int x, int y, int z, int w) {
     if (y <= 0 || y >= 256) {
         return;
     }
-    if (is_destructable(get_block(x, y, z))) {
-        set_block(x, y, z, 0);
+    if (is_destructable(get_block(x, y, z))) {
+        set_block(x, y, z, 0);
+    }
+    if (w) {
+        set_block(x, y, z, w);
+    }
+}
+
+int cull_sections(float planes[6][4], State *s, int p, int q) {
+    // walks outward from the camera's section through the faces that
+    // open space joins, never turning back toward the camera; every
+    // section reached is stamped with this frame and the rest are hidden
+    static const int steps[6][3] = {
+        {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}
+    };
+    Chunk *start = find_chunk(p, q);
+    if (!start) {
+        return 0;
+    }
+    int frame = ++g->cull_frame;
+    CullNode *queue = g->cull_queue;
+    int head = 0;
+    int tail = 0;
+    CullNode *node = queue + tail++;
+    node->chunk = start;
+    node->section = mesh_section(floorf(s->y));
+    node->from = -1;
+    node->dirs = 0;
+    start->sections[node->section].visited = frame;
+    while (head < tail) {
+        node = queue + head++;
+        Chunk *chunk = node->chunk;
+        Section *section = chunk->sections + node->section;
+        for (int i = 0; i < 6; i++) {
+            if (node->dirs >> (i ^ 1) & 1) {
+                continue;
+            }
+            if (node->from >= 0 &&
+                !mesh_connected(section->connect, node->from, i))
+            {
+                continue;
+            }
+            int index = node->section + steps[i][1];
+            if (index < 0 || index >= MESH_SECTIONS) {
+                continue;
+            }
+            Chunk *other = chunk;
+            if (steps[i][0] || steps[i][2]) {
+                other = find_chunk(
+                    chunk->p + steps[i][0], chunk->q + steps[i][2]);
+            }
+            if (!other || chunk_distance(other, p, q) > g->render_radius) {
+                continue;
+            }
+            Section *next = other->sections + index;
+            if (next->visited == frame) {
+                continue;
+            }
+            int y = index * SECTION_HEIGHT;
+            if (!chunk_visible(
+                planes, other->p, other->q, y, y + SECTION_HEIGHT))
+            {
+                continue;
+            }
+            next->visited = frame;
+            CullNode *item = queue + tail++;
+            item->chunk = other;
+            item->section = index;
+            item->from = i ^ 1;
+            item->dirs = node->dirs | (1 << i);
+        }
+    }
+    return 1;
+}
+
+int lod_distance(int a, int b, int span, int p, int q) {
+    // chunks between (p, q) and the nearest chunk of the tile at (a, b)
+    int dp = MAX(MAX(a - p, p - (a + span - 1)), 0);
+    int dq = MAX(MAX(b - q, q - (b + span - 1)), 0);
+    return MAX(dp, dq);
+}
+
+int lod_detailed(Chunk *chunk, int p, int q) {
+    // a chunk is drawn in full only if the finest tile holding it is
+    // split, anything else near the edge of the radius is far terrain
+    int span = LOD_SPAN(1);
+    return !LOD_LEVELS || lod_distance(chunk->p & -span,
+        chunk->q & -span, span, p, q) < g->render_radius;
+}
+
+void request_lod(int level, int a, int b, int distance) {
+    if (g->lod_count >= MAX_LODS ||
+        g->job_count >= g->worker_count * JOBS_PER_WORKER)
+    {
+        return;
+    }
+    Lod *lod = g->lods + g->lod_count++;
+    memset(lod, 0, sizeof(Lod));
+    lod->level = level;
+    lod->p = a;
+    lod->q = b;
+    lod->busy = 1;
+    lod->frame = g->lod_frame;
+    table_set(&g->lod_tables[level], a, b, lod);
+    WorkerItem *item = calloc(1, sizeof(WorkerItem));
+    item->p = a;
+    item->q = b;
+    item->lod = level;
+    // behind every chunk job, nearest tiles first
+    submit_job(item, (1 << 28) | distance);
+}
+
+void visit_lod(
+    Attrib *attrib, float planes[6][4], int level, int a, int b,
+    int p, int q)
+{
+    // a tile that reaches into the next finer ring splits into four,
+    // otherwise it is drawn at this level; level 0 is left to the chunks
+    int span = LOD_SPAN(level);
+    int distance = lod_distance(a, b, span, p, q);
+    if (level == 0) {
+        return;
+    }
+    if (distance < g->render_radius << (level - 1)) {
+        int half = span / 2;
+        for (int i = 0; i < 4; i++) {
+            visit_lod(attrib, planes, level - 1,
+                a + (i & 1) * half, b + (i >> 1) * half, p, q);
+        }
+        return;
+    }
+    Lod *lod = find_lod(level, a, b);
+    if (!lod) {
+        request_lod(level, a, b, distance);
+        return;
     }
-    if (w) {
-        set_block(x, y, z, w);
+    lod->frame = g->lod_frame;
+    if (!lod->faces || !area_visible(planes, a, b, span, 0, lod->maxy)) {
+        return;
+    }
+    draw_mesh(attrib, lod->buffer, lod->faces, a, b);
+    g->lod_faces += lod->faces;
+}
+
+void render_lods(Attrib *attrib, float planes[6][4], int p, int q) {
+    // the rings are one quadtree of tiles over the widest radius, and
+    // every chunk it does not reach down to is covered by exactly one tile
+    int span = LOD_SPAN(LOD_LEVELS);
+    int r = view_radius();
+    g->lod_faces = 0;
+    for (int a = (p - r) & -span; a <= p + r; a += span) {
+        for (int b = (q - r) & -span; b <= q + r; b += span) {
+            if (lod_distance(a, b, span, p, q) <= r) {
+                visit_lod(attrib, planes, LOD_LEVELS, a, b, p, q);
+            }
+        }
     }
 }
 
 int render_chunks(Attrib *attrib, Player *player) {
     int result = 0;
+    int count = 0;
     State *s = &player->state;
     ensure_chunks(player);
     int p = chunked(s->x);
@@ -1616,21 +2539,26 @@ int render_chunks(Attrib *attrib, Player *player) {
     float matrix[16];
     set_matrix_3d(
         matrix, g->width, g->height,
-        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, g->render_radius);
+        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, view_radius());
     float planes[6][4];
-    frustum_planes(planes, g->render_radius, matrix);
+    frustum_planes(planes, view_radius(), matrix);
     glUseProgram(attrib->program);
     glUniformMatrix4fv(attrib->matrix, 1, GL_FALSE, matrix);
     glUniform3f(attrib->camera, s->x, s->y, s->z);
     glUniform1i(attrib->sampler, 0);
     glUniform1i(attrib->extra1, 2);
     glUniform1f(attrib->extra2, light);
-    glUniform1f(attrib->extra3, g->render_radius * CHUNK_SIZE);
+    glUniform1f(attrib->extra3, view_radius() * CHUNK_SIZE);
     glUniform1i(attrib->extra4, g->ortho);
     glUniform1f(attrib->timer, time_of_day());
+    int culled = CAVE_CULLING && CHUNK_ARENA &&
+        cull_sections(planes, s, p, q);
+    g->frustum_faces = 0;
     for (int i = 0; i < g->chunk_count; i++) {
         Chunk *chunk = g->chunks + i;
-        if (chunk_distance(chunk, p, q) > g->render_radius) {
+        if (chunk_distance(chunk, p, q) > g->render_radius ||
+            !lod_detailed(chunk, p, q))
+        {
             continue;
         }
         if (!chunk_visible(
@@ -1638,8 +2566,43 @@ int render_chunks(Attrib *attrib, Player *player) {
         {
             continue;
         }
-        draw_chunk(attrib, chunk);
-        result += chunk->faces;
+        if (chunk->requested && chunk->meshed) {
+            if (g->benchmark) {
+                series_add(&g->flight.latency_ms,
+                    (glfwGetTime() - chunk->requested) * 1000);
+            }
+            chunk->requested = 0;
+        }
+        if (!CHUNK_ARENA) {
+            draw_chunk(attrib, chunk);
+            result += chunk->faces;
+            g->frustum_faces += chunk->faces;
+            continue;
+        }
+        // each section is culled on its own bounds within the chunk,
+        // then dropped if the walk from the camera never reached it
+        for (int j = 0; j < MESH_SECTIONS; j++) {
+            Section *section = chunk->sections + j;
+            if (section->page < 0 || !chunk_visible(planes,
+                chunk->p, chunk->q, section->miny, section->maxy))
+            {
+                continue;
+            }
+            g->frustum_faces += section->faces;
+            if (culled && section->visited != g->cull_frame) {
+                continue;
+            }
+            g->visible[count++] = section;
+            result += section->faces;
+        }
+    }
+    if (CHUNK_ARENA) {
+        draw_chunks(attrib, g->visible, count);
+    }
+    if (LOD_LEVELS) {
+        render_lods(attrib, planes, p, q);
+        result += g->lod_faces;
+        g->frustum_faces += g->lod_faces;
     }
     return result;
 }
@@ -1651,9 +2614,9 @@ void render_signs(Attrib *attrib, Player *player) {
     float matrix[16];
     set_matrix_3d(
         matrix, g->width, g->height,
-        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, g->render_radius);
+        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, view_radius());
     float planes[6][4];
-    frustum_planes(planes, g->render_radius, matrix);
+    frustum_planes(planes, view_radius(), matrix);
     glUseProgram(attrib->program);
     glUniformMatrix4fv(attrib->matrix, 1, GL_FALSE, matrix);
     glUniform1i(attrib->sampler, 3);
@@ -1684,7 +2647,7 @@ void render_sign(Attrib *attrib, Player *player) {
     float matrix[16];
     set_matrix_3d(
         matrix, g->width, g->height,
-        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, g->render_radius);
+        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, view_radius());
     glUseProgram(attrib->program);
     glUniformMatrix4fv(attrib->matrix, 1, GL_FALSE, matrix);
     glUniform1i(attrib->sampler, 3);
@@ -1704,7 +2667,7 @@ void render_players(Attrib *attrib, Player *player) {
     float matrix[16];
     set_matrix_3d(
         matrix, g->width, g->height,
-        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, g->render_radius);
+        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, view_radius());
     glUseProgram(attrib->program);
     glUniformMatrix4fv(attrib->matrix, 1, GL_FALSE, matrix);
     glUniform3f(attrib->camera, s->x, s->y, s->z);
@@ -1736,7 +2699,7 @@ void render_wireframe(Attrib *attrib, Player *player) {
     float matrix[16];
     set_matrix_3d(
         matrix, g->width, g->height,
-        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, g->render_radius);
+        s->x, s->y, s->z, s->rx, s->ry, g->fov, g->ortho, view_radius());
     int hx, hy, hz;
     int hw = hit_test(0, s->x, s->y, s->z, s->rx, s->ry, &hx, &hy, &hz);
     if (is_obstacle(hw)) {
@@ -1848,6 +2811,7 @@ void paste() {
     int oy = p1->y - c1->y;
     int dx = ABS(c2->x - c1->x);
     int dz = ABS(c2->z - c1->z);
+    edit_begin();
     for (int y = 0; y < 256; y++) {
         for (int x = 0; x <= dx; x++) {
             for (int z = 0; z <= dz; z++) {
@@ -1856,6 +2820,7 @@ void paste() {
             }
         }
     }
+    edit_commit();
 }
 
 void array(Block *b1, Block *b2, int xc, int yc, int zc) {
@@ -1869,6 +2834,7 @@ void array(Block *b1, Block *b2, int xc, int yc, int zc) {
     xc = dx ? xc : 1;
     yc = dy ? yc : 1;
     zc = dz ? zc : 1;
+    edit_begin();
     for (int i = 0; i < xc; i++) {
         int x = b1->x + dx * i;
         for (int j = 0; j < yc; j++) {
@@ -1879,6 +2845,7 @@ void array(Block *b1, Block *b2, int xc, int yc, int zc) {
             }
         }
     }
+    edit_commit();
 }
 
 void cube(Block *b1, Block *b2, int fill) {
@@ -1893,6 +2860,7 @@ void cube(Block *b1, Block *b2, int fill) {
     int y2 = MAX(b1->y, b2->y);
     int z2 = MAX(b1->z, b2->z);
     int a = (x1 == x2) + (y1 == y2) + (z1 == z2);
+    edit_begin();
     for (int x = x1; x <= x2; x++) {
         for (int y = y1; y <= y2; y++) {
             for (int z = z1; z <= z2; z++) {
@@ -1909,6 +2877,7 @@ void cube(Block *b1, Block *b2, int fill) {
             }
         }
     }
+    edit_commit();
 }
 
 void sphere(Block *center, int radius, int fill, int fx, int fy, int fz) {
@@ -1926,6 +2895,7 @@ void sphere(Block *center, int radius, int fill, int fx, int fy, int fz) {
     int cy = center->y;
     int cz = center->z;
     int w = center->w;
+    edit_begin();
     for (int x = cx - radius; x <= cx + radius; x++) {
         if (fx && x != cx) {
             continue;
@@ -1958,6 +2928,7 @@ void sphere(Block *center, int radius, int fill, int fx, int fy, int fz) {
             }
         }
     }
+    edit_commit();
 }
 
 void cylinder(Block *b1, Block *b2, int radius, int fill) {
@@ -1978,6 +2949,7 @@ void cylinder(Block *b1, Block *b2, int radius, int fill) {
         return;
     }
     Block block = {x1, y1, z1, w};
+    edit_begin();
     if (fx) {
         for (int x = x1; x <= x2; x++) {
             block.x = x;
@@ -1996,12 +2968,14 @@ void cylinder(Block *b1, Block *b2, int radius, int fill) {
             sphere(&block, radius, fill, 0, 0, 1);
         }
     }
+    edit_commit();
 }
 
 void tree(Block *block) {
     int bx = block->x;
     int by = block->y;
     int bz = block->z;
+    edit_begin();
     for (int y = by + 3; y < by + 8; y++) {
         for (int dx = -3; dx <= 3; dx++) {
             for (int dz = -3; dz <= 3; dz++) {
@@ -2016,6 +2990,569 @@ void tree(Block *block) {
     for (int y = by; y < by + 7; y++) {
         builder_block(bx, y, bz, 5);
     }
+    edit_commit();
+}
+
+Chunk *scan_chunk(Chunk *chunks, int count, int p, int q) {
+    for (int i = 0; i < count; i++) {
+        Chunk *chunk = chunks + i;
+        if (chunk->p == p && chunk->q == q) {
+            return chunk;
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    int ints[7];
+    float floats[5];
+    double real;
+    char *text;
+} Packet;
+
+typedef struct {
+    // one letter per field after the type: i int, f float, d double,
+    // s the rest of the line
+    const char *fields;
+    void (*handler)(Packet *packet);
+} PacketType;
+
+static int parse_number(char **cursor, double *value, int integer) {
+    char *c = *cursor;
+    int negative = *c == '-';
+    c += negative || *c == '+';
+    if (*c < '0' || *c > '9') {
+        return 0;
+    }
+    double result = 0;
+    while (*c >= '0' && *c <= '9') {
+        result = result * 10 + (*c++ - '0');
+    }
+    if (!integer && *c == '.') {
+        double scale = 0.1;
+        for (c++; *c >= '0' && *c <= '9'; c++, scale *= 0.1) {
+            result += (*c - '0') * scale;
+        }
+    }
+    if (!integer && (*c == 'e' || *c == 'E')) {
+        result = strtod(*cursor, &c);
+        negative = 0;
+    }
+    *value = negative ? -result : result;
+    *cursor = c;
+    return 1;
+}
+
+static int parse_fields(char *line, const char *fields, Packet *packet) {
+    int ints = 0;
+    int floats = 0;
+    packet->text = "";
+    for (const char *field = fields; *field; field++) {
+        if (*field == 's') {
+            packet->text = line;
+            return 1;
+        }
+        double value;
+        if (!parse_number(&line, &value, *field == 'i')) {
+            return 0;
+        }
+        if (*field == 'i') {
+            packet->ints[ints++] = (int)value;
+        }
+        else if (*field == 'f') {
+            packet->floats[floats++] = value;
+        }
+        else {
+            packet->real = value;
+        }
+        if (*line == ',') {
+            line++;
+        }
+        else if (field[1] && field[1] != 's') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void flush_blocks() {
+    // block packets for one chunk are applied together and the chunk is
+    // dirtied once for all of them
+    if (!g->batch.size) {
+        return;
+    }
+    set_blocks(g->batch_p, g->batch_q, &g->batch, 1);
+    State *s = &g->players->state;
+    for (unsigned int i = 0; i < g->batch.size; i++) {
+        Edit *b = g->batch.data + i;
+        if (player_intersects_block(2, s->x, s->y, s->z, b->x, b->y, b->z)) {
+            s->y = highest_block(s->x, s->z) + 2;
+            break;
+        }
+    }
+    g->batch.size = 0;
+}
+
+static void packet_you(Packet *packet) {
+    Player *me = g->players;
+    State *s = &g->players->state;
+    float *f = packet->floats;
+    me->id = packet->ints[0];
+    s->x = f[0]; s->y = f[1]; s->z = f[2]; s->rx = f[3]; s->ry = f[4];
+    force_chunks(me);
+    if (f[1] == 0) {
+        s->y = highest_block(s->x, s->z) + 2;
+    }
+}
+
+static void packet_block(Packet *packet) {
+    int *v = packet->ints;
+    if (g->batch.size == MAX_BATCH ||
+        (g->batch.size && (g->batch_p != v[0] || g->batch_q != v[1])))
+    {
+        flush_blocks();
+    }
+    g->batch_p = v[0];
+    g->batch_q = v[1];
+    edit_list_add(&g->batch, v[2], v[3], v[4], v[5]);
+}
+
+static void packet_light(Packet *packet) {
+    int *v = packet->ints;
+    set_light(v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+static void packet_player(Packet *packet) {
+    int pid = packet->ints[0];
+    float *f = packet->floats;
+    Player *player = find_player(pid);
+    if (!player && g->player_count < MAX_PLAYERS) {
+        player = g->players + g->player_count;
+        g->player_count++;
+        player->id = pid;
+        player->buffer = 0;
+        snprintf(player->name, MAX_NAME_LENGTH, "player%d", pid);
+        update_player(player, f[0], f[1], f[2], f[3], f[4], 1); // twice
+    }
+    if (player) {
+        update_player(player, f[0], f[1], f[2], f[3], f[4], 1);
+    }
+}
+
+static void packet_delete(Packet *packet) {
+    delete_player(packet->ints[0]);
+}
+
+static void packet_key(Packet *packet) {
+    db_set_key(packet->ints[0], packet->ints[1], packet->ints[2]);
+}
+
+static void packet_redraw(Packet *packet) {
+    Chunk *chunk = find_chunk(packet->ints[0], packet->ints[1]);
+    if (chunk) {
+        dirty_chunk(chunk);
+    }
+}
+
+static void packet_time(Packet *packet) {
+    int day_length = packet->ints[0];
+    glfwSetTime(fmod(packet->real, day_length));
+    g->day_length = day_length;
+    g->time_changed = 1;
+}
+
+static void packet_talk(Packet *packet) {
+    add_message(packet->text);
+}
+
+static void packet_nick(Packet *packet) {
+    // the name is the first word, like the %s it used to be read with
+    const char *space = " \t\n\v\f\r";
+    const char *name = packet->text + strspn(packet->text, space);
+    int length = strcspn(name, space);
+    Player *player = find_player(packet->ints[0]);
+    if (player && length) {
+        length = MIN(length, MAX_NAME_LENGTH - 1);
+        memcpy(player->name, name, length);
+        player->name[length] = '\0';
+    }
+}
+
+static void packet_sign(Packet *packet) {
+    int *v = packet->ints;
+    char text[MAX_SIGN_LENGTH];
+    snprintf(text, MAX_SIGN_LENGTH, "%s", packet->text);
+    _set_sign(v[0], v[1], v[2], v[3], v[4], v[5], text, 0);
+}
+
+static const PacketType packet_types[128] = {
+    ['B'] = {"iiiiii", packet_block},
+    ['D'] = {"i", packet_delete},
+    ['E'] = {"di", packet_time},
+    ['K'] = {"iii", packet_key},
+    ['L'] = {"iiiiii", packet_light},
+    ['N'] = {"is", packet_nick},
+    ['P'] = {"ifffff", packet_player},
+    ['R'] = {"ii", packet_redraw},
+    ['S'] = {"iiiiiis", packet_sign},
+    ['T'] = {"s", packet_talk},
+    ['U'] = {"ifffff", packet_you},
+};
+
+const PacketType *parse_packet(char *line, Packet *packet) {
+    unsigned char code = line[0];
+    if (code >= 128) {
+        return 0;
+    }
+    const PacketType *type = packet_types + code;
+    if (!type->handler || line[1] != ',') {
+        return 0;
+    }
+    return parse_fields(line + 2, type->fields, packet) ? type : 0;
+}
+
+void parse_line(char *line) {
+    Packet packet;
+    const PacketType *type = parse_packet(line, &packet);
+    if (!type) {
+        return;
+    }
+    // anything else may depend on the blocks before it
+    if (type->handler != packet_block) {
+        flush_blocks();
+    }
+    type->handler(&packet);
+}
+
+void parse_buffer() {
+    // lines are parsed where they lie in the receive ring, and a burst of
+    // chunk data is spread over several frames instead of stalling one
+    double deadline = glfwGetTime() + RECV_TIME_BUDGET;
+    int bytes = 0;
+    int count = 0;
+    char *line;
+    while (bytes < RECV_BYTE_BUDGET && (line = client_recv())) {
+        bytes += strlen(line) + 1;
+        if (g->capture) {
+            fprintf(g->capture, "%s\n", line);
+        }
+        parse_line(line);
+        if (++count % 64 == 0 && glfwGetTime() > deadline) {
+            break;
+        }
+    }
+    flush_blocks();
+}
+
+void bench_chunk_lookup(int radius) {
+    // lay out a full create radius of chunks and probe every (p, q)
+    // in it the way ensure_chunks_worker does, once per pass
+    int passes = 8;
+    int size = radius * 2 + 1;
+    int count = size * size;
+    Chunk *chunks = (Chunk *)calloc(count, sizeof(Chunk));
+    Table table;
+    table_alloc(&table, MAX_CHUNKS * 2 - 1);
+    for (int i = 0; i < count; i++) {
+        Chunk *chunk = chunks + i;
+        chunk->p = i / size - radius;
+        chunk->q = i % size - radius;
+        table_set(&table, chunk->p, chunk->q, chunk);
+    }
+    int found = 0;
+    double t0 = glfwGetTime();
+    for (int i = 0; i < passes; i++) {
+        for (int dp = -radius; dp <= radius; dp++) {
+            for (int dq = -radius; dq <= radius; dq++) {
+                found += scan_chunk(chunks, count, dp, dq) != 0;
+            }
+        }
+    }
+    double t1 = glfwGetTime();
+    for (int i = 0; i < passes; i++) {
+        for (int dp = -radius; dp <= radius; dp++) {
+            for (int dq = -radius; dq <= radius; dq++) {
+                found += table_get(&table, dp, dq) != 0;
+            }
+        }
+    }
+    double t2 = glfwGetTime();
+    double n = (double)count * passes;
+    char text[MAX_TEXT_LENGTH];
+    snprintf(text, MAX_TEXT_LENGTH,
+        "lookup r=%d chunks=%d: scan %.1f ns, table %.1f ns (%d)",
+        radius, count, (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, found);
+    add_message(text);
+    table_free(&table);
+    free(chunks);
+}
+
+double bench_compute(Dense *denses, int greedy, int *faces) {
+    double start = glfwGetTime();
+    for (int i = 0; i < g->chunk_count; i++) {
+        Chunk *chunk = g->chunks + i;
+        WorkerItem _item;
+        WorkerItem *item = &_item;
+        item->p = chunk->p;
+        item->q = chunk->q;
+        item->greedy = greedy;
+        item->simd = SIMD_OCCLUSION;
+        item->sections = SECTION_MASK;
+        for (int dp = -1; dp <= 1; dp++) {
+            for (int dq = -1; dq <= 1; dq++) {
+                Chunk *other = find_chunk(chunk->p + dp, chunk->q + dq);
+                Map *block_map = other ? &other->map : 0;
+                Map *light_map = other ? &other->lights : 0;
+                Dense *dense = other && denses ?
+                    denses + (other - g->chunks) : 0;
+                item->block_maps[dp + 1][dq + 1] = block_map;
+                item->light_maps[dp + 1][dq + 1] = light_map;
+                item->dense_maps[dp + 1][dq + 1] = dense;
+                item->light_fields[dp + 1][dq + 1] =
+                    other ? &other->light_field : 0;
+            }
+        }
+        compute_chunk(item, &g->scratch);
+        if (faces) {
+            faces[i] = item->faces;
+        }
+        pool_give(&g->pool, item->data);
+    }
+    return glfwGetTime() - start;
+}
+
+void bench_storage() {
+    // compare the block maps of every loaded chunk against dense
+    // sections built from them, then mesh all of them both ways
+    int count = g->chunk_count;
+    if (!count) {
+        return;
+    }
+    Dense *denses = (Dense *)malloc(sizeof(Dense) * count);
+    double map_bytes = 0;
+    double dense_bytes_total = 0;
+    for (int i = 0; i < count; i++) {
+        Chunk *chunk = g->chunks + i;
+        dense_from_map(denses + i, &chunk->map);
+        map_bytes += (chunk->map.mask + 2) * sizeof(MapEntry);
+        dense_bytes_total += dense_bytes(denses + i);
+    }
+    double map_time = bench_compute(0, GREEDY_MESHING, 0);
+    double dense_time = bench_compute(denses, GREEDY_MESHING, 0);
+    char text[MAX_TEXT_LENGTH];
+    snprintf(text, MAX_TEXT_LENGTH,
+        "storage %d chunks: map %.1f MB, dense %.1f MB",
+        count, map_bytes / 1048576, dense_bytes_total / 1048576);
+    add_message(text);
+    snprintf(text, MAX_TEXT_LENGTH,
+        "mesh per chunk: map %.2f ms, dense %.2f ms",
+        map_time * 1000 / count, dense_time * 1000 / count);
+    add_message(text);
+    for (int i = 0; i < count; i++) {
+        dense_free(denses + i);
+    }
+    free(denses);
+}
+
+void bench_db() {
+    // load one heavily edited chunk saved as rows and as a blob
+    DbBench result;
+    db_bench(10000, 20, &result);
+    char text[MAX_TEXT_LENGTH];
+    snprintf(text, MAX_TEXT_LENGTH,
+        "10k edits load: rows %.2f ms, blob %.2f ms",
+        result.load_ms[0], result.load_ms[1]);
+    add_message(text);
+    snprintf(text, MAX_TEXT_LENGTH,
+        "10k edits size: rows %lld KB, blob %lld KB",
+        result.bytes[0] / 1024, result.bytes[1] / 1024);
+    add_message(text);
+}
+
+void bench_meshing() {
+    // mesh every loaded chunk with both meshers and compare the output
+    int count = g->chunk_count;
+    if (!count) {
+        return;
+    }
+    int *faces = (int *)calloc(count * 2, sizeof(int));
+    double times[2];
+    double triangles[2] = {0};
+    int most[2] = {0};
+    for (int greedy = 0; greedy < 2; greedy++) {
+        times[greedy] = bench_compute(0, greedy, faces + greedy * count);
+        for (int i = 0; i < count; i++) {
+            int n = faces[greedy * count + i];
+            triangles[greedy] += n * 2;
+            most[greedy] = MAX(most[greedy], n * 2);
+        }
+    }
+    char text[MAX_TEXT_LENGTH];
+    for (int greedy = 0; greedy < 2; greedy++) {
+        double vertices = triangles[greedy] / 2 * FACE_VERTICES;
+        double upload = vertices * 10 * sizeof(GLfloat);
+        double packed = vertices * sizeof(PackedVertex);
+        snprintf(text, MAX_TEXT_LENGTH,
+            "%s: %.0f tris/chunk (max %d), %.1f KB float, %.1f KB packed, "
+            "%.2f ms/chunk",
+            greedy ? "greedy" : "faces", triangles[greedy] / count,
+            most[greedy], upload / 1024 / count, packed / 1024 / count,
+            times[greedy] * 1000 / count);
+        add_message(text);
+    }
+    free(faces);
+}
+
+void bench_occlusion() {
+    // meshes the same generated 3x3 chunks around the origin with the
+    // per block occlusion and with the row kernel, and checks they agree
+    int r = 2;
+    int size = r * 2 + 1;
+    Map *maps = (Map *)malloc(sizeof(Map) * size * size);
+    for (int p = -r; p <= r; p++) {
+        for (int q = -r; q <= r; q++) {
+            Map *map = maps + (p + r) * size + (q + r);
+            int dx = p * CHUNK_SIZE - 1;
+            int dz = q * CHUNK_SIZE - 1;
+            map_alloc(map, dx, 0, dz, 0x7fff);
+            create_world(p, q, map_set_func, map);
+        }
+    }
+    int n = 4;
+    double times[2] = {0};
+    int same = 1;
+    for (int i = 0; i < n; i++) {
+        for (int p = -1; p <= 1; p++) {
+            for (int q = -1; q <= 1; q++) {
+                WorkerItem items[2];
+                for (int simd = 0; simd < 2; simd++) {
+                    WorkerItem *item = items + simd;
+                    memset(item, 0, sizeof(WorkerItem));
+                    item->p = p;
+                    item->q = q;
+                    item->greedy = GREEDY_MESHING;
+                    item->simd = simd;
+                    item->sections = SECTION_MASK;
+                    for (int a = 0; a < 3; a++) {
+                        for (int b = 0; b < 3; b++) {
+                            int index = (p + a - 1 + r) * size + (q + b - 1 + r);
+                            item->block_maps[a][b] = maps + index;
+                        }
+                    }
+                    double start = glfwGetTime();
+                    compute_chunk(item, &g->scratch);
+                    times[simd] += glfwGetTime() - start;
+                }
+                int bytes = mesh_bytes(items[0].faces);
+                if (items[0].faces != items[1].faces ||
+                    memcmp(items[0].data, items[1].data, bytes))
+                {
+                    same = 0;
+                }
+                pool_give(&g->pool, items[0].data);
+                pool_give(&g->pool, items[1].data);
+            }
+        }
+    }
+    for (int i = 0; i < size * size; i++) {
+        map_free(maps + i);
+    }
+    free(maps);
+    char text[MAX_TEXT_LENGTH];
+    snprintf(text, MAX_TEXT_LENGTH,
+        "occlusion: blocks %.2f ms/chunk, %s rows %.2f ms/chunk, %s",
+        times[0] * 1000 / (n * 9), ao_kernel(), times[1] * 1000 / (n * 9),
+        same ? "identical" : "MISMATCH");
+    add_message(text);
+}
+
+int legacy_probe(char *line) {
+    // the sscanf chain parse_line replaced, kept to compare against
+    int a, b, c, d, e, f, face, matched = 0;
+    float u, v, w, x, y;
+    double elapsed;
+    char format[64];
+    char name[MAX_NAME_LENGTH];
+    char text[MAX_SIGN_LENGTH] = {0};
+    matched += sscanf(line, "U,%d,%f,%f,%f,%f,%f", &a, &u, &v, &w, &x, &y) == 6;
+    matched += sscanf(line, "B,%d,%d,%d,%d,%d,%d", &a, &b, &c, &d, &e, &f) == 6;
+    matched += sscanf(line, "L,%d,%d,%d,%d,%d,%d", &a, &b, &c, &d, &e, &f) == 6;
+    matched += sscanf(line, "P,%d,%f,%f,%f,%f,%f", &a, &u, &v, &w, &x, &y) == 6;
+    matched += sscanf(line, "D,%d", &a) == 1;
+    matched += sscanf(line, "K,%d,%d,%d", &a, &b, &c) == 3;
+    matched += sscanf(line, "R,%d,%d", &a, &b) == 2;
+    matched += sscanf(line, "E,%lf,%d", &elapsed, &a) == 2;
+    matched += line[0] == 'T' && line[1] == ',';
+    snprintf(format, sizeof(format), "N,%%d,%%%ds", MAX_NAME_LENGTH - 1);
+    matched += sscanf(line, format, &a, name) == 2;
+    snprintf(
+        format, sizeof(format),
+        "S,%%d,%%d,%%d,%%d,%%d,%%d,%%%d[^\n]", MAX_SIGN_LENGTH - 1);
+    matched += sscanf(line, format, &a, &b, &c, &d, &e, &face, text) >= 6;
+    return matched;
+}
+
+void bench_replay(const char *path) {
+    // replays a stream saved with /capture, parsed the old way and the
+    // table driven way, then applied to the world with saving turned off
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        add_message("bench replay: cannot open file");
+        return;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    rewind(file);
+    char *data = (char *)malloc(length + 1);
+    length = fread(data, 1, length, file);
+    data[length] = '\0';
+    fclose(file);
+    int count = 0;
+    for (long i = 0; i < length; i++) {
+        count += data[i] == '\n';
+    }
+    char **lines = (char **)malloc(sizeof(char *) * (count + 1));
+    count = 0;
+    char *key;
+    char *line = tokenize(data, "\n", &key);
+    while (line) {
+        lines[count++] = line;
+        line = tokenize(NULL, "\n", &key);
+    }
+    double times[3];
+    int matched[2] = {0, 0};
+    double start = glfwGetTime();
+    for (int i = 0; i < count; i++) {
+        matched[0] += legacy_probe(lines[i]);
+    }
+    times[0] = glfwGetTime() - start;
+    start = glfwGetTime();
+    for (int i = 0; i < count; i++) {
+        Packet packet;
+        matched[1] += parse_packet(lines[i], &packet) != 0;
+    }
+    times[1] = glfwGetTime() - start;
+    int enabled = get_db_enabled();
+    db_disable();
+    start = glfwGetTime();
+    for (int i = 0; i < count; i++) {
+        parse_line(lines[i]);
+    }
+    flush_blocks();
+    times[2] = glfwGetTime() - start;
+    if (enabled) {
+        db_enable();
+    }
+    char text[MAX_TEXT_LENGTH];
+    snprintf(text, MAX_TEXT_LENGTH,
+        "replay %d lines: sscanf %.1f ms (%d), table %.1f ms (%d)",
+        count, times[0] * 1000, matched[0], times[1] * 1000, matched[1]);
+    add_message(text);
+    snprintf(text, MAX_TEXT_LENGTH,
+        "replay applied in %.1f ms", times[2] * 1000);
+    add_message(text);
+    free(lines);
+    free(data);
 }
 
 void parse_command(const char *buffer, int forward) {
@@ -2123,6 +3660,38 @@ void parse_command(const char *buffer, int forward) {
     else if (sscanf(buffer, "/cylinder %d", &radius) == 1) {
         cylinder(&g->block0, &g->block1, radius, 0);
     }
+    else if (strcmp(buffer, "/bench lookup") == 0) {
+        bench_chunk_lookup(10);
+        bench_chunk_lookup(20);
+        bench_chunk_lookup(32);
+    }
+    else if (strcmp(buffer, "/bench storage") == 0) {
+        bench_storage();
+    }
+    else if (strcmp(buffer, "/bench mesh") == 0) {
+        bench_meshing();
+    }
+    else if (strcmp(buffer, "/bench ao") == 0) {
+        bench_occlusion();
+    }
+    else if (strcmp(buffer, "/bench db") == 0) {
+        bench_db();
+    }
+    else if (sscanf(buffer, "/bench replay %128s", filename) == 1) {
+        bench_replay(filename);
+    }
+    else if (sscanf(buffer, "/capture %128s", filename) == 1) {
+        if (g->capture) {
+            fclose(g->capture);
+        }
+        g->capture = fopen(filename, "wb");
+    }
+    else if (strcmp(buffer, "/capture") == 0) {
+        if (g->capture) {
+            fclose(g->capture);
+            g->capture = 0;
+        }
+    }
     else if (forward) {
         client_talk(buffer);
     }
@@ -2468,106 +4037,10 @@ void handle_movement(double dt) {
     }
 }
 
-void parse_buffer(char *buffer) {
-    Player *me = g->players;
-    State *s = &g->players->state;
-    char *key;
-    char *line = tokenize(buffer, "\n", &key);
-    while (line) {
-        int pid;
-        float ux, uy, uz, urx, ury;
-        if (sscanf(line, "U,%d,%f,%f,%f,%f,%f",
-            &pid, &ux, &uy, &uz, &urx, &ury) == 6)
-        {
-            me->id = pid;
-            s->x = ux; s->y = uy; s->z = uz; s->rx = urx; s->ry = ury;
-            force_chunks(me);
-            if (uy == 0) {
-                s->y = highest_block(s->x, s->z) + 2;
-            }
-        }
-        int bp, bq, bx, by, bz, bw;
-        if (sscanf(line, "B,%d,%d,%d,%d,%d,%d",
-            &bp, &bq, &bx, &by, &bz, &bw) == 6)
-        {
-            _set_block(bp, bq, bx, by, bz, bw, 0);
-            if (player_intersects_block(2, s->x, s->y, s->z, bx, by, bz)) {
-                s->y = highest_block(s->x, s->z) + 2;
-            }
-        }
-        if (sscanf(line, "L,%d,%d,%d,%d,%d,%d",
-            &bp, &bq, &bx, &by, &bz, &bw) == 6)
-        {
-            set_light(bp, bq, bx, by, bz, bw);
-        }
-        float px, py, pz, prx, pry;
-        if (sscanf(line, "P,%d,%f,%f,%f,%f,%f",
-            &pid, &px, &py, &pz, &prx, &pry) == 6)
-        {
-            Player *player = find_player(pid);
-            if (!player && g->player_count < MAX_PLAYERS) {
-                player = g->players + g->player_count;
-                g->player_count++;
-                player->id = pid;
-                player->buffer = 0;
-                snprintf(player->name, MAX_NAME_LENGTH, "player%d", pid);
-                update_player(player, px, py, pz, prx, pry, 1); // twice
-            }
-            if (player) {
-                update_player(player, px, py, pz, prx, pry, 1);
-            }
-        }
-        if (sscanf(line, "D,%d", &pid) == 1) {
-            delete_player(pid);
-        }
-        int kp, kq, kk;
-        if (sscanf(line, "K,%d,%d,%d", &kp, &kq, &kk) == 3) {
-            db_set_key(kp, kq, kk);
-        }
-        if (sscanf(line, "R,%d,%d", &kp, &kq) == 2) {
-            Chunk *chunk = find_chunk(kp, kq);
-            if (chunk) {
-                dirty_chunk(chunk);
-            }
-        }
-        double elapsed;
-        int day_length;
-        if (sscanf(line, "E,%lf,%d", &elapsed, &day_length) == 2) {
-            glfwSetTime(fmod(elapsed, day_length));
-            g->day_length = day_length;
-            g->time_changed = 1;
-        }
-        if (line[0] == 'T' && line[1] == ',') {
-            char *text = line + 2;
-            add_message(text);
-        }
-        char format[64];
-        snprintf(
-            format, sizeof(format), "N,%%d,%%%ds", MAX_NAME_LENGTH - 1);
-        char name[MAX_NAME_LENGTH];
-        if (sscanf(line, format, &pid, name) == 2) {
-            Player *player = find_player(pid);
-            if (player) {
-                strncpy(player->name, name, MAX_NAME_LENGTH);
-            }
-        }
-        snprintf(
-            format, sizeof(format),
-            "S,%%d,%%d,%%d,%%d,%%d,%%d,%%%d[^\n]", MAX_SIGN_LENGTH - 1);
-        int face;
-        char text[MAX_SIGN_LENGTH] = {0};
-        if (sscanf(line, format,
-            &bp, &bq, &bx, &by, &bz, &face, text) >= 6)
-        {
-            _set_sign(bp, bq, bx, by, bz, face, text, 0);
-        }
-        line = tokenize(NULL, "\n", &key);
-    }
-}
-
 void reset_model() {
     memset(g->chunks, 0, sizeof(Chunk) * MAX_CHUNKS);
     g->chunk_count = 0;
+    table_clear(&g->chunk_table);
     memset(g->players, 0, sizeof(Player) * MAX_PLAYERS);
     g->player_count = 0;
     g->observe1 = 0;
@@ -2579,20 +4052,33 @@ void reset_model() {
     memset(g->messages, 0, sizeof(char) * MAX_MESSAGES * MAX_TEXT_LENGTH);
     g->message_index = 0;
     g->day_length = DAY_LENGTH;
+    g->batch.size = 0;
     glfwSetTime(g->day_length / 3.0);
     g->time_changed = 1;
 }
 
 int main(int argc, char **argv) {
     // INITIALIZATION //
+    if (argc == 3 && strcmp(argv[1], "--benchmark") == 0) {
+        if (!flight_load(&g->flight, argv[2])) {
+            fprintf(stderr, "Unable to load flight path: %s\n", argv[2]);
+            return -1;
+        }
+        g->benchmark = 1;
+    }
     curl_global_init(CURL_GLOBAL_DEFAULT);
-    srand(time(NULL));
+    srand(g->benchmark ? 0 : time(NULL));
     rand();
 
     // WINDOW INITIALIZATION //
     if (!glfwInit()) {
         return -1;
     }
+    if (g->benchmark) {
+        // nothing needs to be seen, so a software renderer without a
+        // display to show it on runs the same path
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    }
     create_window();
     if (!g->window) {
         glfwTerminate();
@@ -2600,7 +4086,7 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(g->window);
-    glfwSwapInterval(VSYNC);
+    glfwSwapInterval(g->benchmark ? 0 : VSYNC);
     glfwSetInputMode(g->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetKeyCallback(g->window, on_key);
     glfwSetCharCallback(g->window, on_char);
@@ -2653,6 +4139,7 @@ int main(int argc, char **argv) {
 
     // LOAD SHADERS //
     Attrib block_attrib = {0};
+    Attrib packed_attrib = {0};
     Attrib line_attrib = {0};
     Attrib text_attrib = {0};
     Attrib sky_attrib = {0};
@@ -2673,6 +4160,23 @@ int main(int argc, char **argv) {
     block_attrib.camera = glGetUniformLocation(program, "camera");
     block_attrib.timer = glGetUniformLocation(program, "timer");
 
+    program = load_program(
+        "shaders/packed_vertex.glsl", "shaders/block_fragment.glsl");
+    packed_attrib.program = program;
+    packed_attrib.position = glGetAttribLocation(program, "position");
+    packed_attrib.normal = glGetAttribLocation(program, "normal");
+    packed_attrib.uv = glGetAttribLocation(program, "uv");
+    packed_attrib.matrix = glGetUniformLocation(program, "matrix");
+    packed_attrib.sampler = glGetUniformLocation(program, "sampler");
+    packed_attrib.extra1 = glGetUniformLocation(program, "sky_sampler");
+    packed_attrib.extra2 = glGetUniformLocation(program, "daylight");
+    packed_attrib.extra3 = glGetUniformLocation(program, "fog_distance");
+    packed_attrib.extra4 = glGetUniformLocation(program, "ortho");
+    packed_attrib.extra5 = glGetUniformLocation(program, "origin");
+    packed_attrib.camera = glGetUniformLocation(program, "camera");
+    packed_attrib.timer = glGetUniformLocation(program, "timer");
+    Attrib *chunk_attrib = PACKED_VERTICES ? &packed_attrib : &block_attrib;
+
     program = load_program(
         "shaders/line_vertex.glsl", "shaders/line_fragment.glsl");
     line_attrib.program = program;
@@ -2699,7 +4203,7 @@ int main(int argc, char **argv) {
     sky_attrib.timer = glGetUniformLocation(program, "timer");
 
     // CHECK COMMAND LINE ARGUMENTS //
-    if (argc == 2 || argc == 3) {
+    if (!g->benchmark && (argc == 2 || argc == 3)) {
         g->mode = MODE_ONLINE;
         strncpy(g->server_addr, argv[1], MAX_ADDR_LENGTH);
         g->server_port = argc == 3 ? atoi(argv[2]) : DEFAULT_PORT;
@@ -2715,14 +4219,28 @@ int main(int argc, char **argv) {
     g->render_radius = RENDER_CHUNK_RADIUS;
     g->delete_radius = DELETE_CHUNK_RADIUS;
     g->sign_radius = RENDER_SIGN_RADIUS;
+    table_alloc(&g->chunk_table, MAX_CHUNKS * 2 - 1);
+    for (int i = 0; i <= LOD_LEVELS; i++) {
+        table_alloc(&g->lod_tables[i], MAX_LODS * 2 - 1);
+    }
+    table_alloc(&g->edit_table, 63);
+    edit_list_alloc(&g->batch, MAX_BATCH);
+    edit_list_alloc(&g->changed, MAX_BATCH);
+    edit_list_alloc(&g->edit_blocks, 1024);
 
     // INITIALIZE WORKER THREADS
-    for (int i = 0; i < WORKERS; i++) {
+    g->worker_count = MIN(get_cpu_count(), MAX_WORKERS);
+    mtx_init(&g->job_mtx, mtx_plain);
+    cnd_init(&g->job_cnd);
+    queue_alloc(&g->done, g->worker_count * JOBS_PER_WORKER);
+    pool_alloc(&g->pool, g->worker_count * JOBS_PER_WORKER * 2);
+    g->scratch.pool = &g->pool;
+    for (int i = 0; i < g->worker_count; i++) {
         Worker *worker = g->workers + i;
         worker->index = i;
-        worker->state = WORKER_IDLE;
+        worker->scratch.pool = &g->pool;
+        heap_alloc(&worker->jobs, JOBS_PER_WORKER);
         mtx_init(&worker->mtx, mtx_plain);
-        cnd_init(&worker->cnd);
         thrd_create(&worker->thrd, worker_run, worker);
     }
 
@@ -2730,11 +4248,22 @@ int main(int argc, char **argv) {
     int running = 1;
     while (running) {
         // DATABASE INITIALIZATION //
-        if (g->mode == MODE_OFFLINE || USE_CACHE) {
+        // a benchmark runs without edits or cached meshes to skew it
+        if ((g->mode == MODE_OFFLINE || USE_CACHE) && !g->benchmark) {
             db_enable();
-            if (db_init(g->db_path)) {
+            // one read connection per worker plus one for the main thread
+            if (db_init(g->db_path, g->worker_count + 1)) {
                 return -1;
             }
+            if (MESH_CACHE) {
+                // a truncated path would name some other directory
+                char path[MAX_PATH_LENGTH + 8];
+                int length = snprintf(
+                    path, sizeof(path), "%s.meshes", g->db_path);
+                if (length < (int)sizeof(path)) {
+                    cache_enable(path);
+                }
+            }
             if (g->mode == MODE_ONLINE) {
                 // TODO: support proper caching of signs (handle deletions)
                 db_delete_all_signs();
@@ -2753,6 +4282,7 @@ int main(int argc, char **argv) {
         // LOCAL VARIABLES //
         reset_model();
         FPS fps = {0, 0, 0};
+        Stats stats = {0};
         double last_commit = glfwGetTime();
         double last_update = glfwGetTime();
         GLuint sky_buffer = gen_sky_buffer();
@@ -2766,6 +4296,11 @@ int main(int argc, char **argv) {
 
         // LOAD STATE FROM DATABASE //
         int loaded = db_load_state(&s->x, &s->y, &s->z, &s->rx, &s->ry);
+        if (g->benchmark) {
+            g->day_length = 0;
+            loaded = flight_sample(
+                &g->flight, 0, &s->x, &s->y, &s->z, &s->rx, &s->ry);
+        }
         force_chunks(me);
         if (!loaded) {
             s->y = highest_block(s->x, s->z) + 2;
@@ -2773,6 +4308,7 @@ int main(int argc, char **argv) {
 
         // BEGIN MAIN LOOP //
         double previous = glfwGetTime();
+        double started = previous;
         while (1) {
             // WINDOW SIZE AND SCALE //
             g->scale = get_scale_factor();
@@ -2787,24 +4323,38 @@ int main(int argc, char **argv) {
                 memset(&fps, 0, sizeof(fps));
             }
             update_fps(&fps);
+            update_stats(&stats);
             double now = glfwGetTime();
             double dt = now - previous;
+            if (g->benchmark && g->flight.frame) {
+                series_add(&g->flight.frame_ms, dt * 1000);
+            }
             dt = MIN(dt, 0.2);
             dt = MAX(dt, 0.0);
             previous = now;
 
-            // HANDLE MOUSE INPUT //
-            handle_mouse_input();
+            if (g->benchmark) {
+                // the path advances a fixed step per frame rather than by
+                // wall time, so every run asks for the same chunks in turn
+                if (!flight_sample(
+                    &g->flight, g->flight.frame * FLIGHT_STEP,
+                    &s->x, &s->y, &s->z, &s->rx, &s->ry))
+                {
+                    running = 0;
+                    break;
+                }
+                g->flight.frame++;
+            }
+            else {
+                // HANDLE MOUSE INPUT //
+                handle_mouse_input();
 
-            // HANDLE MOVEMENT //
-            handle_movement(dt);
+                // HANDLE MOVEMENT //
+                handle_movement(dt);
+            }
 
             // HANDLE DATA FROM SERVER //
-            char *buffer = client_recv();
-            if (buffer) {
-                parse_buffer(buffer);
-                free(buffer);
-            }
+            parse_buffer();
 
             // FLUSH DATABASE //
             if (now - last_commit > COMMIT_INTERVAL) {
@@ -2822,6 +4372,7 @@ int main(int argc, char **argv) {
             g->observe1 = g->observe1 % g->player_count;
             g->observe2 = g->observe2 % g->player_count;
             delete_chunks();
+            delete_lods();
             del_buffer(me->buffer);
             me->buffer = gen_player_buffer(s->x, s->y, s->z, s->rx, s->ry);
             for (int i = 1; i < g->player_count; i++) {
@@ -2834,7 +4385,10 @@ int main(int argc, char **argv) {
             glClear(GL_DEPTH_BUFFER_BIT);
             render_sky(&sky_attrib, player, sky_buffer);
             glClear(GL_DEPTH_BUFFER_BIT);
-            int face_count = render_chunks(&block_attrib, player);
+            int face_count = render_chunks(chunk_attrib, player);
+            if (g->benchmark) {
+                series_add(&g->flight.faces, face_count);
+            }
             render_signs(&text_attrib, player);
             render_sign(&text_attrib, player);
             render_players(&block_attrib, player);
@@ -2863,10 +4417,22 @@ int main(int argc, char **argv) {
                 hour = hour ? hour : 12;
                 snprintf(
                     text_buffer, 1024,
-                    "(%d, %d) (%.2f, %.2f, %.2f) [%d, %d, %d] %d%cm %dfps",
+                    "(%d, %d) (%.2f, %.2f, %.2f) [%d, %d, %d -%d%%] "
+                    "%d%cm %dfps",
                     chunked(s->x), chunked(s->z), s->x, s->y, s->z,
-                    g->player_count, g->chunk_count,
-                    face_count * 2, hour, am_pm, fps.fps);
+                    g->player_count, g->chunk_count, face_count * 2,
+                    g->frustum_faces ?
+                        100 - face_count * 100 / g->frustum_faces : 0,
+                    hour, am_pm, fps.fps);
+                render_text(&text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
+                ty -= ts * 2;
+            }
+            if (SHOW_DEBUG_TEXT) {
+                snprintf(
+                    text_buffer, 1024,
+                    "map copy %.2f MB/s, shared %.2f MB/s, %d allocs/job",
+                    stats.copied_rate / 1048576, stats.shared_rate / 1048576,
+                    g->job_allocs);
                 render_text(&text_attrib, ALIGN_LEFT, tx, ty, ts, text_buffer);
                 ty -= ts * 2;
             }
@@ -2923,7 +4489,7 @@ int main(int argc, char **argv) {
 
                 render_sky(&sky_attrib, player, sky_buffer);
                 glClear(GL_DEPTH_BUFFER_BIT);
-                render_chunks(&block_attrib, player);
+                render_chunks(chunk_attrib, player);
                 render_signs(&text_attrib, player);
                 render_players(&block_attrib, player);
                 glClear(GL_DEPTH_BUFFER_BIT);
@@ -2947,16 +4513,37 @@ int main(int argc, char **argv) {
         }
 
         // SHUTDOWN //
+        if (g->benchmark) {
+            double busy[MAX_WORKERS];
+            for (int i = 0; i < g->worker_count; i++) {
+                Worker *worker = g->workers + i;
+                mtx_lock(&worker->mtx);
+                busy[i] = worker->busy;
+                mtx_unlock(&worker->mtx);
+            }
+            flight_report(stdout, &g->flight, glfwGetTime() - started,
+                busy, g->worker_count);
+        }
         db_save_state(s->x, s->y, s->z, s->rx, s->ry);
         db_close();
         db_disable();
+        cache_disable();
         client_stop();
         client_disable();
         del_buffer(sky_buffer);
         delete_all_chunks();
+        delete_all_lods();
         delete_all_players();
     }
 
+    del_buffer(g->index_buffer);
+    table_free(&g->chunk_table);
+    for (int i = 0; i <= LOD_LEVELS; i++) {
+        table_free(&g->lod_tables[i]);
+    }
+    if (g->benchmark) {
+        flight_free(&g->flight);
+    }
     glfwTerminate();
     curl_global_cleanup();
     return 0;
@@ -2,6 +2,9 @@
 #include <string.h>
 #include "map.h"
 
+static unsigned long long copied_bytes = 0;
+static unsigned long long shared_bytes = 0;
+
 int hash_int(int key) {
     key = ~key + (key << 15);
     key = key ^ (key >> 12);
@@ -25,21 +28,52 @@ void map_alloc(Map *map, int dx, int dy, int dz, int mask) {
     map->dz = dz;
     map->mask = mask;
     map->size = 0;
-    map->data = (MapEntry *)calloc(map->mask + 1, sizeof(MapEntry));
+    map->data = (MapEntry *)calloc(map->mask + 2, sizeof(MapEntry));
+    *MAP_REFS(map) = 1;
 }
 
 void map_free(Map *map) {
-    free(map->data);
+    if (__atomic_sub_fetch(MAP_REFS(map), 1, __ATOMIC_ACQ_REL) == 0) {
+        free(map->data);
+    }
 }
 
 void map_copy(Map *dst, Map *src) {
+    unsigned int bytes = (src->mask + 1) * sizeof(MapEntry);
     dst->dx = src->dx;
     dst->dy = src->dy;
     dst->dz = src->dz;
     dst->mask = src->mask;
     dst->size = src->size;
-    dst->data = (MapEntry *)calloc(dst->mask + 1, sizeof(MapEntry));
-    memcpy(dst->data, src->data, (dst->mask + 1) * sizeof(MapEntry));
+    dst->data = (MapEntry *)calloc(dst->mask + 2, sizeof(MapEntry));
+    memcpy(dst->data, src->data, bytes);
+    *MAP_REFS(dst) = 1;
+    __atomic_add_fetch(&copied_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void map_snapshot(Map *dst, Map *src) {
+    unsigned int bytes = (src->mask + 1) * sizeof(MapEntry);
+    __atomic_add_fetch(MAP_REFS(src), 1, __ATOMIC_RELAXED);
+    memcpy(dst, src, sizeof(Map));
+    __atomic_add_fetch(&shared_bytes, bytes, __ATOMIC_RELAXED);
+}
+
+static void map_unshare(Map *map) {
+    if (__atomic_load_n(MAP_REFS(map), __ATOMIC_ACQUIRE) == 1) {
+        return;
+    }
+    Map copy;
+    map_copy(&copy, map);
+    map_free(map);
+    map->data = copy.data;
+}
+
+unsigned long long map_copied_bytes() {
+    return __atomic_load_n(&copied_bytes, __ATOMIC_RELAXED);
+}
+
+unsigned long long map_shared_bytes() {
+    return __atomic_load_n(&shared_bytes, __ATOMIC_RELAXED);
 }
 
 int map_set(Map *map, int x, int y, int z, int w) {
@@ -59,11 +93,15 @@ int map_set(Map *map, int x, int y, int z, int w) {
     }
     if (overwrite) {
         if (entry->e.w != w) {
+            map_unshare(map);
+            entry = map->data + index;
             entry->e.w = w;
             return 1;
         }
     }
     else if (w) {
+        map_unshare(map);
+        entry = map->data + index;
         entry->e.x = x;
         entry->e.y = y;
         entry->e.z = z;
@@ -103,11 +141,12 @@ void map_grow(Map *map) {
     new_map.dz = map->dz;
     new_map.mask = (map->mask << 1) | 1;
     new_map.size = 0;
-    new_map.data = (MapEntry *)calloc(new_map.mask + 1, sizeof(MapEntry));
+    new_map.data = (MapEntry *)calloc(new_map.mask + 2, sizeof(MapEntry));
+    *MAP_REFS(&new_map) = 1;
     MAP_FOR_EACH(map, ex, ey, ez, ew) {
         map_set(&new_map, ex, ey, ez, ew);
     } END_MAP_FOR_EACH;
-    free(map->data);
+    map_free(map);
     map->mask = new_map.mask;
     map->size = new_map.size;
     map->data = new_map.data;
@@ -26,6 +26,10 @@ typedef union {
     } e;
 } MapEntry;
 
+// data is shared between snapshots and carries a reference count in the
+// slot just past the last entry; writers copy it first if it is shared
+#define MAP_REFS(map) (&(map)->data[(map)->mask + 1].value)
+
 typedef struct {
     int dx;
     int dy;
@@ -38,8 +42,11 @@ typedef struct {
 void map_alloc(Map *map, int dx, int dy, int dz, int mask);
 void map_free(Map *map);
 void map_copy(Map *dst, Map *src);
+void map_snapshot(Map *dst, Map *src);
 void map_grow(Map *map);
 int map_set(Map *map, int x, int y, int z, int w);
 int map_get(Map *map, int x, int y, int z);
+unsigned long long map_copied_bytes();
+unsigned long long map_shared_bytes();
 
 #endif
@@ -0,0 +1,1024 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ao.h"
+#include "cube.h"
+#include "db.h"
+#include "item.h"
+#include "mesh.h"
+#include "noise.h"
+#include "util.h"
+#include "world.h"
+
+static void occlusion(
+    char neighbors[27], char lights[27], float shades[27],
+    float ao[6][4], float light[6][4])
+{
+    static const int lookup3[6][4][3] = {
+        {{0, 1, 3}, {2, 1, 5}, {6, 3, 7}, {8, 5, 7}},
+        {{18, 19, 21}, {20, 19, 23}, {24, 21, 25}, {26, 23, 25}},
+        {{6, 7, 15}, {8, 7, 17}, {24, 15, 25}, {26, 17, 25}},
+        {{0, 1, 9}, {2, 1, 11}, {18, 9, 19}, {20, 11, 19}},
+        {{0, 3, 9}, {6, 3, 15}, {18, 9, 21}, {24, 15, 21}},
+        {{2, 5, 11}, {8, 5, 17}, {20, 11, 23}, {26, 17, 23}}
+    };
+   static const int lookup4[6][4][4] = {
+        {{0, 1, 3, 4}, {1, 2, 4, 5}, {3, 4, 6, 7}, {4, 5, 7, 8}},
+        {{18, 19, 21, 22}, {19, 20, 22, 23}, {21, 22, 24, 25}, {22, 23, 25, 26}},
+        {{6, 7, 15, 16}, {7, 8, 16, 17}, {15, 16, 24, 25}, {16, 17, 25, 26}},
+        {{0, 1, 9, 10}, {1, 2, 10, 11}, {9, 10, 18, 19}, {10, 11, 19, 20}},
+        {{0, 3, 9, 12}, {3, 6, 12, 15}, {9, 12, 18, 21}, {12, 15, 21, 24}},
+        {{2, 5, 11, 14}, {5, 8, 14, 17}, {11, 14, 20, 23}, {14, 17, 23, 26}}
+    };
+    static const float curve[4] = {0.0, 0.25, 0.5, 0.75};
+    for (int i = 0; i < 6; i++) {
+        for (int j = 0; j < 4; j++) {
+            int corner = neighbors[lookup3[i][j][0]];
+            int side1 = neighbors[lookup3[i][j][1]];
+            int side2 = neighbors[lookup3[i][j][2]];
+            int value = side1 && side2 ? 3 : corner + side1 + side2;
+            float shade_sum = 0;
+            float light_sum = 0;
+            int is_light = lights[13] == 15;
+            for (int k = 0; k < 4; k++) {
+                shade_sum += shades[lookup4[i][j][k]];
+                light_sum += lights[lookup4[i][j][k]];
+            }
+            if (is_light) {
+                light_sum = 15 * 4 * 10;
+            }
+            float total = curve[value] + shade_sum / 4.0;
+            ao[i][j] = MIN(total, 1.0);
+            light[i][j] = light_sum / 15.0 / 4.0;
+        }
+    }
+}
+
+#define XZ_SIZE (CHUNK_SIZE * 3 + 2)
+#define XZ_LO (CHUNK_SIZE)
+#define XZ_HI (CHUNK_SIZE * 2 + 1)
+#define Y_SIZE 258
+#define XYZ(x, y, z) ((y) * XZ_SIZE * XZ_SIZE + (x) * XZ_SIZE + (z))
+#define XZ(x, z) ((x) * XZ_SIZE + (z))
+
+static void *scratch_reserve(
+    Scratch *scratch, void *data, int *capacity, int size)
+{
+    if (size <= *capacity) {
+        return data;
+    }
+    free(data);
+    *capacity = size + size / 4;
+    scratch->allocs++;
+    return malloc(*capacity);
+}
+
+static void scratch_begin(Scratch *scratch) {
+    // the volumes are only cleared up to the highest layer the previous
+    // job wrote, which is usually well below the top of the world
+    int layer = XZ_SIZE * XZ_SIZE;
+    if (!scratch->opaque) {
+        scratch->opaque = (char *)calloc(layer * Y_SIZE, sizeof(char));
+        scratch->light = (char *)calloc(layer * Y_SIZE, sizeof(char));
+        scratch->shade = (char *)calloc(layer * Y_SIZE, sizeof(char));
+        scratch->highest = (char *)calloc(layer, sizeof(char));
+        scratch->allocs += 4;
+    }
+    else {
+        memset(scratch->opaque, 0, layer * scratch->opaque_top);
+        memset(scratch->light, 0, layer * scratch->light_top);
+        memset(scratch->highest, 0, layer);
+    }
+    scratch->opaque_top = 0;
+    scratch->light_top = 0;
+}
+
+static void set_opaque(
+    char *opaque, char *highest, int x, int y, int z, int w)
+{
+    // TODO: this should be unnecessary
+    if (x < 0 || y < 0 || z < 0) {
+        return;
+    }
+    if (x >= XZ_SIZE || y >= Y_SIZE || z >= XZ_SIZE) {
+        return;
+    }
+    // END TODO
+    opaque[XYZ(x, y, z)] = !is_transparent(w);
+    if (opaque[XYZ(x, y, z)]) {
+        highest[XZ(x, z)] = MAX(highest[XZ(x, z)], y);
+    }
+}
+
+static int collect_blocks(WorkerItem *item, Scratch *scratch) {
+    Dense *dense = item->dense_maps[1][1];
+    Map *map = item->block_maps[1][1];
+    int capacity = 0;
+    if (dense) {
+        for (int i = 0; i < DENSE_SECTIONS; i++) {
+            if (dense->sections[i]) {
+                capacity += dense->sections[i]->count;
+            }
+        }
+    }
+    else {
+        capacity = map->size;
+    }
+    scratch->blocks = scratch_reserve(scratch, scratch->blocks,
+        &scratch->block_capacity, sizeof(Block) * MAX(capacity, 1));
+    Block *blocks = scratch->blocks;
+    int sections = item->sections;
+    int count = 0;
+    if (dense) {
+        // dense sections are visited bottom up and evenly divide a mesh
+        // section, so these come out in section order already
+        DENSE_FOR_EACH(dense, ex, ey, ez, ew) {
+            if (ew > 0 && (sections >> mesh_section(ey) & 1)) {
+                Block *block = blocks + count++;
+                block->x = ex; block->y = ey; block->z = ez; block->w = ew;
+            }
+        } END_DENSE_FOR_EACH;
+        return count;
+    }
+    MAP_FOR_EACH(map, ex, ey, ez, ew) {
+        if (ew > 0 && (sections >> mesh_section(ey) & 1)) {
+            Block *block = blocks + count++;
+            block->x = ex; block->y = ey; block->z = ez; block->w = ew;
+        }
+    } END_MAP_FOR_EACH;
+    // counting sort by section, stable so rows stay together for ao_row
+    int start[MESH_SECTIONS + 1] = {0};
+    for (int i = 0; i < count; i++) {
+        start[mesh_section(blocks[i].y) + 1]++;
+    }
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        start[i + 1] += start[i];
+    }
+    scratch->sorted = scratch_reserve(scratch, scratch->sorted,
+        &scratch->sorted_capacity, sizeof(Block) * MAX(count, 1));
+    for (int i = 0; i < count; i++) {
+        scratch->sorted[start[mesh_section(blocks[i].y)]++] = blocks[i];
+    }
+    scratch->blocks = scratch->sorted;
+    scratch->sorted = blocks;
+    int capacity_swap = scratch->block_capacity;
+    scratch->block_capacity = scratch->sorted_capacity;
+    scratch->sorted_capacity = capacity_swap;
+    return count;
+}
+
+static void block_occlusion(
+    char *opaque, char *light, char *highest,
+    int x, int y, int z, float ao[6][4], float face_light[6][4])
+{
+    char neighbors[27] = {0};
+    char lights[27] = {0};
+    float shades[27] = {0};
+    int index = 0;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                neighbors[index] = opaque[XYZ(x + dx, y + dy, z + dz)];
+                lights[index] = light[XYZ(x + dx, y + dy, z + dz)];
+                shades[index] = 0;
+                if (y + dy <= highest[XZ(x + dx, z + dz)]) {
+                    for (int oy = 0; oy < 8; oy++) {
+                        if (opaque[XYZ(x + dx, y + dy + oy, z + dz)]) {
+                            shades[index] = 1.0 - oy * 0.125;
+                            break;
+                        }
+                    }
+                }
+                index++;
+            }
+        }
+    }
+    occlusion(neighbors, lights, shades, ao, face_light);
+}
+
+#define GREEDY_U 32
+#define GREEDY_V 256
+
+// normal, u and v axis of each cube face, matching make_cube_quad
+static const int greedy_axes[6][3] = {
+    {0, 2, 1}, {0, 2, 1}, {1, 0, 2}, {1, 0, 2}, {2, 0, 1}, {2, 0, 1}
+};
+
+static void add_greedy_faces(
+    GreedyFace *faces, int *count, int exposed[6],
+    float ao[6][4], float light[6][4], int x, int y, int z, int w)
+{
+    // x, y, z are relative to the chunk origin
+    int position[3] = {x, y, z};
+    for (int i = 0; i < 6; i++) {
+        if (!exposed[i]) {
+            continue;
+        }
+        GreedyFace *face = faces + (*count)++;
+        face->face = i;
+        face->slice = position[greedy_axes[i][0]];
+        face->u = position[greedy_axes[i][1]];
+        face->v = position[greedy_axes[i][2]];
+        face->w = blocks[w][i];
+        face->mergeable =
+            face->u >= 0 && face->u < GREEDY_U &&
+            face->v >= 0 && face->v < GREEDY_V;
+        for (int j = 0; j < 4; j++) {
+            face->ao[j] = ao[i][j];
+            face->light[j] = light[i][j];
+            if (ao[i][j] != ao[i][0] || light[i][j] != light[i][0]) {
+                face->mergeable = 0;
+            }
+        }
+    }
+}
+
+static int greedy_face_compare(const void *a, const void *b) {
+    const GreedyFace *fa = (const GreedyFace *)a;
+    const GreedyFace *fb = (const GreedyFace *)b;
+    if (fa->face != fb->face) {
+        return fa->face - fb->face;
+    }
+    return fa->slice - fb->slice;
+}
+
+static int greedy_match(
+    GreedyFace *faces, int *mask, int index, GreedyFace *face)
+{
+    int k = mask[index];
+    if (!k) {
+        return 0;
+    }
+    GreedyFace *other = faces + k - 1;
+    return other->mergeable && other->w == face->w &&
+        other->ao[0] == face->ao[0] && other->light[0] == face->light[0];
+}
+
+static void emit_greedy_quad(
+    float *data, GreedyFace *face, int p, int q, int width, int height)
+{
+    int a[3];
+    int b[3];
+    a[greedy_axes[face->face][0]] = face->slice;
+    a[greedy_axes[face->face][1]] = face->u;
+    a[greedy_axes[face->face][2]] = face->v;
+    b[greedy_axes[face->face][0]] = face->slice;
+    b[greedy_axes[face->face][1]] = face->u + width - 1;
+    b[greedy_axes[face->face][2]] = face->v + height - 1;
+    int dx = p * CHUNK_SIZE;
+    int dz = q * CHUNK_SIZE;
+    make_cube_quad(
+        data, face->ao, face->light, face->face, face->w,
+        a[0] + dx, a[1], a[2] + dz, b[0] + dx, b[1], b[2] + dz, 0.5);
+}
+
+static int greedy_mesh(
+    float *data, int *mask, GreedyFace *faces, int count, int p, int q)
+{
+    // merges coplanar faces with the same tile and uniform ao and light
+    // into larger quads, returns the number of quads written to data;
+    // every mask cell that gets set is cleared again when it is emitted
+    int quads = 0;
+    qsort(faces, count, sizeof(GreedyFace), greedy_face_compare);
+    int start = 0;
+    while (start < count) {
+        int end = start;
+        int u1 = GREEDY_U;
+        int v1 = GREEDY_V;
+        int u2 = -1;
+        int v2 = -1;
+        while (end < count && greedy_face_compare(faces + start, faces + end) == 0) {
+            GreedyFace *face = faces + end;
+            if (face->mergeable) {
+                mask[face->v * GREEDY_U + face->u] = end + 1;
+                u1 = MIN(u1, face->u);
+                v1 = MIN(v1, face->v);
+                u2 = MAX(u2, face->u);
+                v2 = MAX(v2, face->v);
+            }
+            else {
+                emit_greedy_quad(data + quads++ * 60, face, p, q, 1, 1);
+            }
+            end++;
+        }
+        for (int v = v1; v <= v2; v++) {
+            for (int u = u1; u <= u2; u++) {
+                int k = mask[v * GREEDY_U + u];
+                if (!k) {
+                    continue;
+                }
+                GreedyFace *face = faces + k - 1;
+                int width = 1;
+                while (u + width <= u2 &&
+                    greedy_match(faces, mask, v * GREEDY_U + u + width, face))
+                {
+                    width++;
+                }
+                int height = 1;
+                while (v + height <= v2 && height < CHUNK_SIZE) {
+                    int row = (v + height) * GREEDY_U;
+                    int match = 1;
+                    for (int du = 0; du < width; du++) {
+                        if (!greedy_match(faces, mask, row + u + du, face)) {
+                            match = 0;
+                            break;
+                        }
+                    }
+                    if (!match) {
+                        break;
+                    }
+                    height++;
+                }
+                for (int dv = 0; dv < height; dv++) {
+                    for (int du = 0; du < width; du++) {
+                        mask[(v + dv) * GREEDY_U + u + du] = 0;
+                    }
+                }
+                emit_greedy_quad(data + quads++ * 60, face, p, q, width, height);
+            }
+        }
+        start = end;
+    }
+    return quads;
+}
+
+int mesh_section(int y) {
+    return y < 0 ? 0 : MIN(y / SECTION_HEIGHT, MESH_SECTIONS - 1);
+}
+
+static const int face_pairs[6][6] = {
+    {-1, 0, 1, 2, 3, 4},
+    {0, -1, 5, 6, 7, 8},
+    {1, 5, -1, 9, 10, 11},
+    {2, 6, 9, -1, 12, 13},
+    {3, 7, 10, 12, -1, 14},
+    {4, 8, 11, 13, 14, -1}
+};
+
+int mesh_connected(int connect, int a, int b) {
+    return a == b || (connect >> face_pairs[a][b] & 1);
+}
+
+int mesh_region(int p) {
+    return p < 0 ? (p - MESH_REGION + 1) / MESH_REGION : p / MESH_REGION;
+}
+
+static int pack_normal(float nx, float ny, float nz) {
+    // 240 steps around the y axis, then up and down
+    if (ny > 0.5) {
+        return 240;
+    }
+    if (ny < -0.5) {
+        return 241;
+    }
+    int angle = roundf(atan2f(nz, nx) / (2 * PI) * 240);
+    return (angle + 240) % 240;
+}
+
+static void pack_faces(
+    PackedVertex *result, float *data, int faces, int p, int q)
+{
+    // converts the 10 float vertices from make_cube, make_cube_quad and
+    // make_plant into the 12 byte layout read by packed_vertex.glsl
+    int n = FACE_VERTICES;
+    float ox = mesh_region(p) * MESH_REGION * CHUNK_SIZE;
+    float oz = mesh_region(q) * MESH_REGION * CHUNK_SIZE;
+    for (int i = 0; i < faces; i++) {
+        float *face = data + i * n * 10;
+        float u1 = face[6];
+        float v1 = face[7];
+        for (int j = 1; j < n; j++) {
+            u1 = MIN(u1, face[j * 10 + 6]);
+            v1 = MIN(v1, face[j * 10 + 7]);
+        }
+        // tiled uvs already hold block offsets, atlas uvs hold corners
+        int tiled = u1 >= 64;
+        int col = tiled ? floorf(u1 / 64) - 1 : floorf(u1 * 16 + 0.001);
+        int row = tiled ? floorf(v1 / 64) - 1 : floorf(v1 * 16 + 0.001);
+        for (int j = 0; j < n; j++) {
+            float *d = face + j * 10;
+            PackedVertex *vertex = result + i * n + j;
+            vertex->x = roundf((d[0] - ox) * 64);
+            vertex->y = roundf(d[1] * 64);
+            vertex->z = roundf((d[2] - oz) * 64);
+            vertex->normal = pack_normal(d[3], d[4], d[5]);
+            vertex->tile = row * 16 + col;
+            if (tiled) {
+                vertex->u = roundf(d[6] - (col + 1) * 64);
+                vertex->v = roundf(d[7] - (row + 1) * 64);
+            }
+            else {
+                vertex->u = roundf(d[6] * 16 - col);
+                vertex->v = roundf(d[7] * 16 - row);
+            }
+            vertex->ao = roundf(d[8] * 32);
+            vertex->light = roundf(MIN(d[9], 1) * 60);
+        }
+    }
+}
+
+#define FLOOD_SIZE (CHUNK_SIZE * SECTION_HEIGHT * CHUNK_SIZE)
+#define FLOOD(x, y, z) (((y) * CHUNK_SIZE + (x)) * CHUNK_SIZE + (z))
+
+static int section_connect(Scratch *scratch, char *opaque, int section) {
+    // flood fills the open voxels of one section and joins every pair of
+    // faces that a single open region touches
+    int base = section * SECTION_HEIGHT;
+    if (base + 1 >= scratch->opaque_top) {
+        return SECTION_OPEN;
+    }
+    if (!scratch->flood) {
+        scratch->flood = (char *)malloc(FLOOD_SIZE);
+        scratch->stack = (int *)malloc(sizeof(int) * FLOOD_SIZE);
+        scratch->allocs += 2;
+    }
+    char *flood = scratch->flood;
+    int *stack = scratch->stack;
+    for (int y = 0; y < SECTION_HEIGHT; y++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                flood[FLOOD(x, y, z)] = opaque[XYZ(
+                    x + CHUNK_SIZE + 1, y + base + 1, z + CHUNK_SIZE + 1)];
+            }
+        }
+    }
+    int result = 0;
+    for (int start = 0; start < FLOOD_SIZE && result != SECTION_OPEN;
+        start++)
+    {
+        if (flood[start]) {
+            continue;
+        }
+        int faces = 0;
+        int size = 0;
+        flood[start] = 1;
+        stack[size++] = start;
+        while (size) {
+            int index = stack[--size];
+            int z = index % CHUNK_SIZE;
+            int x = index / CHUNK_SIZE % CHUNK_SIZE;
+            int y = index / CHUNK_SIZE / CHUNK_SIZE;
+            int near[6][3] = {
+                {x - 1, y, z}, {x + 1, y, z}, {x, y - 1, z},
+                {x, y + 1, z}, {x, y, z - 1}, {x, y, z + 1}
+            };
+            for (int i = 0; i < 6; i++) {
+                int nx = near[i][0];
+                int ny = near[i][1];
+                int nz = near[i][2];
+                if (nx < 0 || ny < 0 || nz < 0 || nx >= CHUNK_SIZE ||
+                    ny >= SECTION_HEIGHT || nz >= CHUNK_SIZE)
+                {
+                    faces |= 1 << i;
+                    continue;
+                }
+                int other = FLOOD(nx, ny, nz);
+                if (!flood[other]) {
+                    flood[other] = 1;
+                    stack[size++] = other;
+                }
+            }
+        }
+        for (int a = 0; a < 6; a++) {
+            for (int b = a + 1; b < 6; b++) {
+                if ((faces >> a & 1) && (faces >> b & 1)) {
+                    result |= 1 << face_pairs[a][b];
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void compute_chunk(WorkerItem *item, Scratch *scratch) {
+    scratch->allocs = 0;
+    scratch_begin(scratch);
+    char *opaque = scratch->opaque;
+    char *light = scratch->light;
+    char *highest = scratch->highest;
+    int top = 0;
+
+    int ox = item->p * CHUNK_SIZE - CHUNK_SIZE - 1;
+    int oy = -1;
+    int oz = item->q * CHUNK_SIZE - CHUNK_SIZE - 1;
+
+    // check for lights
+    int has_light = 0;
+    if (SHOW_LIGHTS) {
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) {
+                Dense *field = item->light_fields[a][b];
+                if (field && dense_bytes(field)) {
+                    has_light = 1;
+                }
+            }
+        }
+    }
+
+    // populate opaque array
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            Dense *dense = item->dense_maps[a][b];
+            Map *map = item->block_maps[a][b];
+            if (dense) {
+                DENSE_FOR_EACH(dense, ex, ey, ez, ew) {
+                    set_opaque(opaque, highest,
+                        ex - ox, ey - oy, ez - oz, ew);
+                    top = MAX(top, ey - oy + 1);
+                } END_DENSE_FOR_EACH;
+            }
+            else if (map) {
+                MAP_FOR_EACH(map, ex, ey, ez, ew) {
+                    set_opaque(opaque, highest,
+                        ex - ox, ey - oy, ez - oz, ew);
+                    top = MAX(top, ey - oy + 1);
+                } END_MAP_FOR_EACH;
+            }
+        }
+    }
+    top = MIN(top, Y_SIZE);
+    scratch->opaque_top = top;
+
+    // copy light intensities
+    if (has_light) {
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < 3; b++) {
+                Dense *field = item->light_fields[a][b];
+                if (!field) {
+                    continue;
+                }
+                DENSE_FOR_EACH(field, ex, ey, ez, ew) {
+                    int x = ex - ox;
+                    int y = ey - oy;
+                    int z = ez - oz;
+                    if (x >= 0 && x < XZ_SIZE && z >= 0 && z < XZ_SIZE) {
+                        light[XYZ(x, y, z)] = ew;
+                        scratch->light_top = MAX(scratch->light_top, y + 1);
+                    }
+                } END_DENSE_FOR_EACH;
+            }
+        }
+    }
+
+    int block_count = collect_blocks(item, scratch);
+    Block *blocks = scratch->blocks;
+
+    // count exposed faces
+    MeshSections table = {0};
+    table.mask = item->sections;
+    for (int i = 0; i < MESH_SECTIONS; i++) {
+        table.miny[i] = 256;
+        table.connect[i] = SECTION_OPEN;
+        if (CAVE_CULLING && (item->sections >> i & 1)) {
+            table.connect[i] = section_connect(scratch, opaque, i);
+        }
+    }
+    int miny = 256;
+    int maxy = 0;
+    int faces = 0;
+    for (int i = 0; i < block_count; i++) {
+        int ex = blocks[i].x;
+        int ey = blocks[i].y;
+        int ez = blocks[i].z;
+        int ew = blocks[i].w;
+        int x = ex - ox;
+        int y = ey - oy;
+        int z = ez - oz;
+        int f1 = !opaque[XYZ(x - 1, y, z)];
+        int f2 = !opaque[XYZ(x + 1, y, z)];
+        int f3 = !opaque[XYZ(x, y + 1, z)];
+        int f4 = !opaque[XYZ(x, y - 1, z)] && (ey > 0);
+        int f5 = !opaque[XYZ(x, y, z - 1)];
+        int f6 = !opaque[XYZ(x, y, z + 1)];
+        int total = f1 + f2 + f3 + f4 + f5 + f6;
+        if (total == 0) {
+            continue;
+        }
+        if (is_plant(ew)) {
+            total = 4;
+        }
+        int s = mesh_section(ey);
+        table.miny[s] = MIN(table.miny[s], ey);
+        table.maxy[s] = MAX(table.maxy[s], ey);
+        miny = MIN(miny, ey);
+        maxy = MAX(maxy, ey);
+        faces += total;
+    }
+
+    // shade each voxel around the chunk once instead of per block
+    char *shade = 0;
+    AoRow row;
+    int row_x = -1;
+    int row_y = -1;
+    if (item->simd) {
+        // nothing above the top layer is read, so only shade up to it
+        shade = scratch->shade;
+        ao_shade(shade, opaque, highest,
+            XZ_SIZE, MIN(top + 1, Y_SIZE), XZ_LO, XZ_HI);
+    }
+
+    // generate geometry
+    int size = sizeof(float) * 6 * 10 * faces;
+    float *data;
+    if (PACKED_VERTICES) {
+        scratch->data = scratch_reserve(
+            scratch, scratch->data, &scratch->data_capacity, size);
+        data = scratch->data;
+    }
+    else {
+        item->data = pool_take(scratch->pool,
+            sizeof(MeshSections) + size, &scratch->allocs);
+        data = (float *)((MeshSections *)item->data + 1);
+    }
+    GreedyFace *greedy = 0;
+    int greedy_count = 0;
+    if (item->greedy) {
+        scratch->greedy = scratch_reserve(scratch, scratch->greedy,
+            &scratch->greedy_capacity, sizeof(GreedyFace) * MAX(faces, 1));
+        greedy = scratch->greedy;
+        if (!scratch->mask) {
+            scratch->mask = calloc(GREEDY_U * GREEDY_V, sizeof(int));
+            scratch->allocs++;
+        }
+    }
+    int offset = 0;
+    int section = -1;
+    int section_offset = 0;
+    for (int i = 0; i <= block_count; i++) {
+        int s = i < block_count ? mesh_section(blocks[i].y) : MESH_SECTIONS;
+        if (s != section) {
+            // greedy quads are merged per section so none crosses a border
+            if (greedy && greedy_count) {
+                offset += greedy_mesh(data + offset, scratch->mask,
+                    greedy, greedy_count, item->p, item->q) * 60;
+                greedy_count = 0;
+            }
+            if (section >= 0) {
+                table.faces[section] = (offset - section_offset) / 60;
+            }
+            section = s;
+            section_offset = offset;
+        }
+        if (i == block_count) {
+            break;
+        }
+        int ex = blocks[i].x;
+        int ey = blocks[i].y;
+        int ez = blocks[i].z;
+        int ew = blocks[i].w;
+        int x = ex - ox;
+        int y = ey - oy;
+        int z = ez - oz;
+        int f1 = !opaque[XYZ(x - 1, y, z)];
+        int f2 = !opaque[XYZ(x + 1, y, z)];
+        int f3 = !opaque[XYZ(x, y + 1, z)];
+        int f4 = !opaque[XYZ(x, y - 1, z)] && (ey > 0);
+        int f5 = !opaque[XYZ(x, y, z - 1)];
+        int f6 = !opaque[XYZ(x, y, z + 1)];
+        int total = f1 + f2 + f3 + f4 + f5 + f6;
+        if (total == 0) {
+            continue;
+        }
+        float ao[6][4];
+        float face_light[6][4];
+        if (shade) {
+            if (x != row_x || y != row_y) {
+                ao_row(&row, opaque, light, shade,
+                    XZ_SIZE, x, y, XZ_LO + 1, CHUNK_SIZE);
+                row_x = x;
+                row_y = y;
+            }
+            ao_unpack(&row, z - XZ_LO - 1, ao, face_light);
+        }
+        else {
+            block_occlusion(opaque, light, highest, x, y, z, ao, face_light);
+        }
+        if (is_plant(ew)) {
+            total = 4;
+            float min_ao = 1;
+            float max_light = 0;
+            for (int a = 0; a < 6; a++) {
+                for (int b = 0; b < 4; b++) {
+                    min_ao = MIN(min_ao, ao[a][b]);
+                    max_light = MAX(max_light, face_light[a][b]);
+                }
+            }
+            float rotation = simplex2(ex, ez, 4, 0.5, 2) * 360;
+            make_plant(
+                data + offset, min_ao, max_light,
+                ex, ey, ez, 0.5, ew, rotation);
+        }
+        else if (greedy) {
+            int exposed[6] = {f1, f2, f3, f4, f5, f6};
+            add_greedy_faces(
+                greedy, &greedy_count, exposed, ao, face_light,
+                ex - item->p * CHUNK_SIZE, ey, ez - item->q * CHUNK_SIZE, ew);
+            continue;
+        }
+        else {
+            make_cube(
+                data + offset, ao, face_light,
+                f1, f2, f3, f4, f5, f6,
+                ex, ey, ez, 0.5, ew);
+        }
+        offset += total * 60;
+    }
+    faces = offset / 60;
+
+    item->miny = miny;
+    item->maxy = maxy;
+    item->faces = faces;
+    if (INDEXED_QUADS) {
+        make_quads(data, faces);
+    }
+    if (PACKED_VERTICES) {
+        item->data = pool_take(scratch->pool,
+            mesh_bytes(faces), &scratch->allocs);
+        pack_faces((PackedVertex *)((MeshSections *)item->data + 1),
+            data, faces, item->p, item->q);
+    }
+    memcpy(item->data, &table, sizeof(MeshSections));
+    item->allocs = scratch->allocs;
+}
+
+int chunk_bytes(int faces) {
+    int size = PACKED_VERTICES ? sizeof(PackedVertex) : sizeof(float) * 10;
+    return size * FACE_VERTICES * faces;
+}
+
+int mesh_bytes(int faces) {
+    return sizeof(MeshSections) + chunk_bytes(faces);
+}
+
+void free_item_data(WorkerItem *item, Pool *pool) {
+    if (item->hit.base) {
+        cache_release(&item->hit);
+    }
+    else {
+        pool_give(pool, item->data);
+    }
+}
+
+void map_set_func(int x, int y, int z, int w, void *arg) {
+    Map *map = (Map *)arg;
+    map_set(map, x, y, z, w);
+}
+
+void load_chunk(WorkerItem *item, int reader) {
+    int p = item->p;
+    int q = item->q;
+    Map *block_map = item->block_maps[1][1];
+    Map *light_map = item->light_maps[1][1];
+    create_world(p, q, map_set_func, block_map);
+    // the mesh cache key needs the edits of all nine chunks, which come
+    // back from the same queries as this chunk's own
+    int hashed = get_cache_enabled() && db_committed(item->commit);
+    db_load_area(reader, p, q, block_map, light_map,
+        hashed ? item->hashes : 0);
+    item->hashed = hashed && db_committed(item->commit);
+    if (item->dense_maps[1][1]) {
+        dense_from_map(item->dense_maps[1][1], block_map);
+    }
+}
+
+static unsigned long long chunk_key(WorkerItem *item) {
+    // the world generator is deterministic, so a finished mesh depends only
+    // on the edits saved in and around its chunk and on how it was meshed
+    int flags[] = {
+        MESH_VERSION, CHUNK_SIZE, item->greedy, PACKED_VERTICES,
+        INDEXED_QUADS, SHOW_LIGHTS, SHOW_PLANTS, SHOW_CLOUDS, SHOW_TREES
+    };
+    unsigned long long key = 0;
+    for (unsigned int i = 0; i < sizeof(flags) / sizeof(int); i++) {
+        key = key * 31 + flags[i];
+    }
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            key = key * 1000003 + item->hashes[a][b];
+        }
+    }
+    return key;
+}
+
+static int light_free(WorkerItem *item) {
+    // a chunk that is still loading has no light of its own yet, which
+    // leaves its mesh exact only when nothing around it is lit
+    Map *lights = item->light_maps[1][1];
+    if (lights && lights->size) {
+        return 0;
+    }
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            Dense *field = item->light_fields[a][b];
+            for (int s = 0; field && s < DENSE_SECTIONS; s++) {
+                if (field->sections[s] && field->sections[s]->count) {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+void mesh_chunk(WorkerItem *item, Scratch *scratch, int reader) {
+    item->hit.base = 0;
+    item->allocs = 0;
+    // only whole meshes are cached, keyed on the edits the database holds,
+    // and only when those are exactly the edits the maps were taken with:
+    // every one of them committed before the read and none since
+    if (!get_cache_enabled() || item->sections != SECTION_MASK) {
+        compute_chunk(item, scratch);
+        return;
+    }
+    if (!item->load && db_committed(item->commit)) {
+        db_load_area(reader, item->p, item->q, 0, 0, item->hashes);
+        item->hashed = db_committed(item->commit);
+    }
+    if (!item->hashed) {
+        compute_chunk(item, scratch);
+        return;
+    }
+    unsigned long long key = chunk_key(item);
+    CacheHit *hit = &item->hit;
+    if (cache_load(hit, item->p, item->q, key)) {
+        item->miny = hit->miny;
+        item->maxy = hit->maxy;
+        item->faces = hit->faces;
+        item->data = hit->data;
+        item->complete = 1;
+        return;
+    }
+    compute_chunk(item, scratch);
+    if (item->complete) {
+        item->complete = light_free(item);
+    }
+    // only meshes built with all their neighbors in place are kept
+    if (item->complete) {
+        cache_store(
+            item->p, item->q, key, item->faces, item->miny, item->maxy,
+            item->data, mesh_bytes(item->faces));
+    }
+}
+
+static int lod_cubes(int height, int step) {
+    return (height + step / 2) / step;
+}
+
+static void lod_edits(
+    WorkerItem *item, int reader, int step, int *heights, int *tops)
+{
+    // stored edits raise a cell to the highest obstacle placed in it and
+    // lower it when the top of its sampled column was dug out
+    if (!get_db_enabled()) {
+        return;
+    }
+    int size = LOD_CELLS + 2;
+    int span = LOD_SPAN(item->lod);
+    int x0 = item->p * CHUNK_SIZE;
+    int z0 = item->q * CHUNK_SIZE;
+    for (int dp = 0; dp < span; dp++) {
+        for (int dq = 0; dq < span; dq++) {
+            int p = item->p + dp;
+            int q = item->q + dq;
+            Map map;
+            Map lights;
+            map_alloc(&map, p * CHUNK_SIZE - 1, 0, q * CHUNK_SIZE - 1, 0xff);
+            map_alloc(&lights, p * CHUNK_SIZE - 1, 0, q * CHUNK_SIZE - 1, 0xf);
+            db_load_area(reader, p, q, &map, &lights, 0);
+            MAP_FOR_EACH((&map), ex, ey, ez, ew) {
+                // the border holds copies of the neighbors' edits, negated
+                // where they were placed, which their own chunks supply
+                int a = ex - p * CHUNK_SIZE;
+                int b = ez - q * CHUNK_SIZE;
+                if (a < 0 || b < 0 || a >= CHUNK_SIZE || b >= CHUNK_SIZE) {
+                    continue;
+                }
+                int x = ex - x0;
+                int z = ez - z0;
+                int i = (x / step + 1) * size + (z / step + 1);
+                if (is_obstacle(ew) && ey >= heights[i]) {
+                    heights[i] = ey + 1;
+                    tops[i] = ew;
+                }
+                else if (!is_obstacle(ew) && ey == heights[i] - 1 &&
+                    x % step == 0 && z % step == 0)
+                {
+                    heights[i] = ey;
+                }
+            } END_MAP_FOR_EACH;
+            map_free(&map);
+            map_free(&lights);
+        }
+    }
+}
+
+static const int lod_walls[4][3] = {
+    {0, -1, 0}, {1, 1, 0}, {4, 0, -1}, {5, 0, 1}
+};
+
+static int lod_wall(int *cubes, int size, int a, int b, int j) {
+    // the cube count the wall on side j of cell a, b comes down to, with
+    // walls on the tile edge reaching one cube further down as a skirt so
+    // that tiles of other levels next to it leave no cracks
+    int n = cubes[a * size + b];
+    int da = lod_walls[j][1];
+    int db = lod_walls[j][2];
+    int other = cubes[(a + da) * size + (b + db)];
+    if (a + da < 1 || a + da > LOD_CELLS || b + db < 1 || b + db > LOD_CELLS) {
+        other = MAX(MIN(other, n) - 1, 0);
+    }
+    return MIN(other, n);
+}
+
+void mesh_lod(WorkerItem *item, Scratch *scratch, int reader) {
+    // one cube per cell stacked up to the surface, with a top quad per
+    // run of equal cells and a wall wherever a neighbor is lower; no quad
+    // is longer than a chunk on either side so that its texture offsets
+    // stay inside one atlas tile, as with greedy meshing
+    int size = LOD_CELLS + 2;
+    int step = LOD_SPAN(item->lod) * CHUNK_SIZE / LOD_CELLS;
+    int x0 = item->p * CHUNK_SIZE;
+    int z0 = item->q * CHUNK_SIZE;
+    int heights[(LOD_CELLS + 2) * (LOD_CELLS + 2)];
+    int tops[(LOD_CELLS + 2) * (LOD_CELLS + 2)];
+    int cubes[(LOD_CELLS + 2) * (LOD_CELLS + 2)];
+    scratch->allocs = 0;
+    create_heights(x0 - step, z0 - step, step, size, heights, tops);
+    lod_edits(item, reader, step, heights, tops);
+    for (int i = 0; i < size * size; i++) {
+        cubes[i] = lod_cubes(heights[i], step);
+    }
+    int limit = LOD_CELLS * LOD_CELLS;
+    for (int a = 1; a <= LOD_CELLS; a++) {
+        for (int b = 1; b <= LOD_CELLS; b++) {
+            for (int j = 0; j < 4; j++) {
+                int n = cubes[a * size + b];
+                int height = (n - lod_wall(cubes, size, a, b, j)) * step;
+                limit += (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+            }
+        }
+    }
+    scratch->data = scratch_reserve(scratch, scratch->data,
+        &scratch->data_capacity, sizeof(float) * 60 * limit);
+    float *data = scratch->data;
+    float ao[4] = {0};
+    float light[4] = {0};
+    int run = CHUNK_SIZE / step;
+    int faces = 0;
+    int maxy = 0;
+    for (int a = 1; a <= LOD_CELLS; a++) {
+        int next = 1;
+        for (int b = 1; b <= LOD_CELLS; b++) {
+            int i = a * size + b;
+            int n = cubes[i];
+            int w = tops[i];
+            int x1 = x0 + (a - 1) * step;
+            int z1 = z0 + (b - 1) * step;
+            int top = n * step - 1;
+            maxy = MAX(maxy, top + 1);
+            if (b == next) {
+                int end = b;
+                while (end < LOD_CELLS && end - b + 1 < run &&
+                    cubes[i + end - b + 1] == n && tops[i + end - b + 1] == w)
+                {
+                    end++;
+                }
+                next = end + 1;
+                make_cube_quad(data + faces++ * 60, ao, light,
+                    2, blocks[w][2], x1, top, z1,
+                    x1 + step - 1, top, z0 + end * step - 1, 0.5);
+            }
+            for (int j = 0; j < 4; j++) {
+                int da = lod_walls[j][1];
+                int db = lod_walls[j][2];
+                int x = da > 0 ? x1 + step - 1 : x1;
+                int z = db > 0 ? z1 + step - 1 : z1;
+                int face = lod_walls[j][0];
+                int y = lod_wall(cubes, size, a, b, j) * step;
+                for (; y <= top; y += CHUNK_SIZE) {
+                    make_cube_quad(data + faces++ * 60, ao, light,
+                        face, blocks[w][face],
+                        da ? x : x1, y, db ? z : z1,
+                        da ? x : x1 + step - 1, MIN(y + CHUNK_SIZE - 1, top),
+                        db ? z : z1 + step - 1, 0.5);
+                }
+            }
+        }
+    }
+    if (INDEXED_QUADS) {
+        make_quads(data, faces);
+    }
+    item->data = pool_take(scratch->pool,
+        chunk_bytes(faces), &scratch->allocs);
+    if (PACKED_VERTICES) {
+        pack_faces(item->data, data, faces, item->p, item->q);
+    }
+    else {
+        memcpy(item->data, data, chunk_bytes(faces));
+    }
+    item->faces = faces;
+    item->miny = 0;
+    item->maxy = maxy;
+    item->hit.base = 0;
+    item->allocs = scratch->allocs;
+}
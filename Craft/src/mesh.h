@@ -0,0 +1,136 @@
+#ifndef _mesh_h_
+#define _mesh_h_
+
+#include "cache.h"
+#include "config.h"
+#include "dense.h"
+#include "map.h"
+#include "pool.h"
+
+// turns the blocks of a chunk and its eight neighbors into vertex data;
+// nothing here touches the gpu, the caller uploads the finished buffer
+
+#define FACE_VERTICES (INDEXED_QUADS ? 4 : 6)
+#define MESH_VERSION 4
+
+// a chunk is meshed in horizontal slices, so an edit only rebuilds the
+// slices it touches and each slice is culled on its own bounds
+#define MESH_SECTIONS 8
+#define SECTION_HEIGHT (256 / MESH_SECTIONS)
+#define SECTION_MASK ((1 << MESH_SECTIONS) - 1)
+
+// which pairs of the six faces of a section are joined by open space,
+// faces ordered -x, +x, -y, +y, -z, +z with one bit per pair
+#define SECTION_OPEN 0x7fff
+
+// packed vertices are stored relative to the corner of the square of
+// MESH_REGION x MESH_REGION chunks they fall in, which still fits a short
+// and lets every chunk of the square be drawn with the same origin
+#define MESH_REGION 8
+
+// far terrain is drawn in square tiles of LOD_SPAN(level) chunks, each
+// LOD_CELLS columns wide, so a cell stands for a cube of span blocks;
+// the widest tile must still fit in one MESH_REGION
+#define LOD_CELLS 32
+#define LOD_SPAN(level) (1 << (level))
+
+typedef struct {
+    int p;
+    int q;
+    int load;
+    int lod;
+    int greedy;
+    int simd;
+    int sections;
+    int complete;
+    int commit;
+    int hashed;
+    unsigned long long hashes[3][3];
+    Map *block_maps[3][3];
+    Map *light_maps[3][3];
+    Dense *dense_maps[3][3];
+    Dense *light_fields[3][3];
+    int miny;
+    int maxy;
+    int faces;
+    int allocs;
+    void *data;
+    CacheHit hit;
+} WorkerItem;
+
+typedef struct {
+    int x;
+    int y;
+    int z;
+    int w;
+} Block;
+
+// leads the vertex data of every mesh, which holds the faces of the
+// sections in mask one after another from the bottom up
+typedef struct {
+    int mask;
+    int faces[MESH_SECTIONS];
+    int miny[MESH_SECTIONS];
+    int maxy[MESH_SECTIONS];
+    int connect[MESH_SECTIONS];
+    int pad[3];
+} MeshSections;
+
+typedef struct {
+    short x;
+    short y;
+    short z;
+    unsigned char normal;
+    unsigned char tile;
+    unsigned char u;
+    unsigned char v;
+    unsigned char ao;
+    unsigned char light;
+} PackedVertex;
+
+typedef struct {
+    int face;
+    int slice;
+    int u;
+    int v;
+    int w;
+    int mergeable;
+    float ao[4];
+    float light[4];
+} GreedyFace;
+
+typedef struct {
+    char *opaque;
+    char *light;
+    char *highest;
+    char *shade;
+    int opaque_top;
+    int light_top;
+    Block *blocks;
+    int block_capacity;
+    Block *sorted;
+    int sorted_capacity;
+    GreedyFace *greedy;
+    int greedy_capacity;
+    int *mask;
+    char *flood;
+    int *stack;
+    float *data;
+    int data_capacity;
+    int allocs;
+    Pool *pool;
+} Scratch;
+
+int mesh_region(int p);
+int mesh_section(int y);
+int mesh_connected(int connect, int a, int b);
+int mesh_bytes(int faces);
+void compute_chunk(WorkerItem *item, Scratch *scratch);
+int chunk_bytes(int faces);
+void free_item_data(WorkerItem *item, Pool *pool);
+void map_set_func(int x, int y, int z, int w, void *arg);
+void load_chunk(WorkerItem *item, int reader);
+void mesh_chunk(WorkerItem *item, Scratch *scratch, int reader);
+void mesh_lod(WorkerItem *item, Scratch *scratch, int reader);
+
+#endif
@@ -0,0 +1,48 @@
+#include <stdlib.h>
+#include "pool.h"
+
+typedef struct {
+    int size;
+    int pad[3];
+} PoolHeader;
+
+void pool_alloc(Pool *pool, int capacity) {
+    queue_alloc(&pool->queue, capacity);
+}
+
+void pool_free(Pool *pool) {
+    void *data;
+    while (queue_pop(&pool->queue, &data)) {
+        free(data);
+    }
+    queue_free(&pool->queue);
+}
+
+void *pool_take(Pool *pool, int size, int *allocs) {
+    void *data;
+    PoolHeader *header = 0;
+    if (queue_pop(&pool->queue, &data)) {
+        header = (PoolHeader *)data;
+    }
+    if (!header || header->size < size) {
+        // leave some room so the next slightly larger chunk still fits
+        int capacity = size + size / 4;
+        free(header);
+        header = (PoolHeader *)malloc(sizeof(PoolHeader) + capacity);
+        header->size = capacity;
+        if (allocs) {
+            (*allocs)++;
+        }
+    }
+    return header + 1;
+}
+
+void pool_give(Pool *pool, void *data) {
+    if (!data) {
+        return;
+    }
+    PoolHeader *header = (PoolHeader *)data - 1;
+    if (!queue_push(&pool->queue, header)) {
+        free(header);
+    }
+}
@@ -0,0 +1,19 @@
+#ifndef _pool_h_
+#define _pool_h_
+
+#include "queue.h"
+
+// recycled buffers that the workers fill and the main thread hands back
+// once it is done with them; buffers only ever grow, so after a while
+// every one of them is large enough and taking one allocates nothing
+
+typedef struct {
+    Queue queue;
+} Pool;
+
+void pool_alloc(Pool *pool, int capacity);
+void pool_free(Pool *pool);
+void *pool_take(Pool *pool, int size, int *allocs);
+void pool_give(Pool *pool, void *data);
+
+#endif
@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cache.h"
+#include "common.h"
+#include "config.h"
+#include "db.h"
+#include "mesh.h"
+#include "pool.h"
+#include "tinycthread.h"
+
+// headless pregeneration: builds and meshes a square of chunks on every
+// core without a window, storing the meshes in the mesh cache next to the
+// database, or with -b times the same work at each thread count
+
+#define MAX_THREADS 64
+#define MAX_PATH_LENGTH 256
+
+typedef struct {
+    Map map;
+    Map lights;
+    Dense dense;
+    WorkerItem item;
+    long long bytes;
+} Column;
+
+typedef struct {
+    Column *columns;
+    int p;
+    int q;
+    int radius;
+    int size;
+    int count;
+    int next;
+    int phase;
+    mtx_t mtx;
+    Pool pool;
+} Region;
+
+typedef struct {
+    int index;
+    thrd_t thrd;
+    Region *region;
+    Scratch scratch;
+} Thread;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(TIME_UTC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Column *region_column(Region *region, int p, int q) {
+    // the square holds a one chunk border that is generated but not meshed
+    int a = p - region->p + region->radius + 1;
+    int b = q - region->q + region->radius + 1;
+    return region->columns + a * region->size + b;
+}
+
+static void region_alloc(Region *region, int p, int q, int radius) {
+    region->p = p;
+    region->q = q;
+    region->radius = radius;
+    region->size = radius * 2 + 3;
+    region->columns = (Column *)calloc(
+        region->size * region->size, sizeof(Column));
+    mtx_init(&region->mtx, mtx_plain);
+}
+
+static void region_free(Region *region) {
+    region->count = region->size * region->size;
+    for (int i = 0; i < region->count; i++) {
+        Column *column = region->columns + i;
+        if (column->map.data) {
+            map_free(&column->map);
+            map_free(&column->lights);
+            dense_free(&column->dense);
+        }
+    }
+    free(region->columns);
+    mtx_destroy(&region->mtx);
+}
+
+static void generate_column(Region *region, int index, int reader) {
+    int p = region->p - region->radius - 1 + index / region->size;
+    int q = region->q - region->radius - 1 + index % region->size;
+    Column *column = region_column(region, p, q);
+    if (column->map.data) {
+        map_free(&column->map);
+        map_free(&column->lights);
+        dense_free(&column->dense);
+    }
+    int dx = p * CHUNK_SIZE - 1;
+    int dz = q * CHUNK_SIZE - 1;
+    map_alloc(&column->map, dx, 0, dz, 0x7fff);
+    map_alloc(&column->lights, dx, 0, dz, 0xf);
+    dense_alloc(&column->dense, dx, dz);
+    WorkerItem *item = &column->item;
+    memset(item, 0, sizeof(WorkerItem));
+    item->p = p;
+    item->q = q;
+    item->block_maps[1][1] = &column->map;
+    item->light_maps[1][1] = &column->lights;
+    item->dense_maps[1][1] = DENSE_STORAGE ? &column->dense : 0;
+    load_chunk(item, reader);
+}
+
+static void mesh_column(Region *region, int index, Thread *thread) {
+    int width = region->radius * 2 + 1;
+    int p = region->p - region->radius + index / width;
+    int q = region->q - region->radius + index % width;
+    Column *column = region_column(region, p, q);
+    WorkerItem *item = &column->item;
+    item->load = 1;
+    item->greedy = GREEDY_MESHING;
+    item->simd = SIMD_OCCLUSION;
+    item->sections = SECTION_MASK;
+    // light is not propagated here, so only meshes with no light source
+    // anywhere around them are exact enough to keep
+    item->complete = 1;
+    for (int a = 0; a < 3; a++) {
+        for (int b = 0; b < 3; b++) {
+            Column *other = region_column(region, p + a - 1, q + b - 1);
+            item->block_maps[a][b] = &other->map;
+            item->light_maps[a][b] = &other->lights;
+            item->dense_maps[a][b] = DENSE_STORAGE ? &other->dense : 0;
+            item->light_fields[a][b] = 0;
+            if (other->lights.size) {
+                item->complete = 0;
+            }
+        }
+    }
+    mesh_chunk(item, &thread->scratch, thread->index);
+    column->bytes = mesh_bytes(item->faces);
+    free_item_data(item, &region->pool);
+}
+
+static int thread_run(void *arg) {
+    Thread *thread = (Thread *)arg;
+    Region *region = thread->region;
+    while (1) {
+        mtx_lock(&region->mtx);
+        int index = region->next++;
+        mtx_unlock(&region->mtx);
+        if (index >= region->count) {
+            break;
+        }
+        if (region->phase == 0) {
+            generate_column(region, index, thread->index);
+        }
+        else {
+            mesh_column(region, index, thread);
+        }
+    }
+    return 0;
+}
+
+static double run_phase(
+    Region *region, Thread *threads, int count, int phase, int jobs)
+{
+    region->phase = phase;
+    region->count = jobs;
+    region->next = 0;
+    double start = now();
+    for (int i = 0; i < count; i++) {
+        thrd_create(&threads[i].thrd, thread_run, threads + i);
+    }
+    for (int i = 0; i < count; i++) {
+        thrd_join(threads[i].thrd, NULL);
+    }
+    return now() - start;
+}
+
+static void run(Region *region, Thread *threads, int count) {
+    int size = region->size;
+    int width = region->radius * 2 + 1;
+    double generate = run_phase(region, threads, count, 0, size * size);
+    double mesh = run_phase(region, threads, count, 1, width * width);
+    long long bytes = 0;
+    long long faces = 0;
+    for (int a = 0; a < width; a++) {
+        for (int b = 0; b < width; b++) {
+            Column *column = region_column(region,
+                region->p - region->radius + a,
+                region->q - region->radius + b);
+            bytes += column->bytes;
+            faces += column->item.faces;
+        }
+    }
+    printf("%2d threads: generate %6.1f chunks/s, "
+        "mesh %6.1f chunks/s %7.1f MB/s, %lld faces\n",
+        count, size * size / generate, width * width / mesh,
+        bytes / mesh / (1024 * 1024), faces);
+}
+
+static void usage() {
+    printf("usage: craft-pregen [-d db] [-r radius] [-c p q] "
+        "[-t threads] [-b]\n");
+}
+
+int main(int argc, char **argv) {
+    char db_path[MAX_PATH_LENGTH];
+    snprintf(db_path, MAX_PATH_LENGTH, "%s", DB_PATH);
+    int radius = CREATE_CHUNK_RADIUS;
+    int p = 0;
+    int q = 0;
+    int threads = 0;
+    int bench = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            snprintf(db_path, MAX_PATH_LENGTH, "%s", argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            radius = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-c") && i + 2 < argc) {
+            p = atoi(argv[++i]);
+            q = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-b")) {
+            bench = 1;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if (radius < 0) {
+        usage();
+        return 1;
+    }
+    int limit = MIN(get_cpu_count(), MAX_THREADS);
+    if (threads < 1 || threads > MAX_THREADS) {
+        threads = limit;
+    }
+    db_enable();
+    if (db_init(db_path, threads)) {
+        return -1;
+    }
+    // a benchmark measures the work itself, so it never reads or writes
+    // meshes; a normal run leaves them where the game looks for them
+    if (MESH_CACHE && !bench) {
+        char path[MAX_PATH_LENGTH + 8];
+        snprintf(path, sizeof(path), "%s.meshes", db_path);
+        cache_enable(path);
+    }
+    Region region;
+    region_alloc(&region, p, q, radius);
+    pool_alloc(&region.pool, threads * 2);
+    Thread *workers = (Thread *)calloc(threads, sizeof(Thread));
+    for (int i = 0; i < threads; i++) {
+        workers[i].index = i;
+        workers[i].region = &region;
+        workers[i].scratch.pool = &region.pool;
+    }
+    if (bench) {
+        for (int count = 1; count < threads; count <<= 1) {
+            run(&region, workers, count);
+        }
+    }
+    run(&region, workers, threads);
+    free(workers);
+    pool_free(&region.pool);
+    region_free(&region);
+    db_close();
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include "queue.h"
+
+#define LOAD(x, order) __atomic_load_n(&(x), order)
+#define STORE(x, v, order) __atomic_store_n(&(x), v, order)
+#define CAS(x, expected, v) __atomic_compare_exchange_n( \
+    &(x), expected, v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+void queue_alloc(Queue *queue, int capacity) {
+    unsigned int size = 1;
+    while (size < (unsigned int)capacity) {
+        size <<= 1;
+    }
+    queue->mask = size - 1;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->cells = (QueueCell *)calloc(size, sizeof(QueueCell));
+    for (unsigned int i = 0; i < size; i++) {
+        queue->cells[i].sequence = i;
+    }
+}
+
+void queue_free(Queue *queue) {
+    free(queue->cells);
+}
+
+int queue_push(Queue *queue, void *data) {
+    unsigned int pos = LOAD(queue->head, __ATOMIC_RELAXED);
+    while (1) {
+        QueueCell *cell = queue->cells + (pos & queue->mask);
+        unsigned int sequence = LOAD(cell->sequence, __ATOMIC_ACQUIRE);
+        int diff = (int)(sequence - pos);
+        if (diff == 0) {
+            if (CAS(queue->head, &pos, pos + 1)) {
+                cell->data = data;
+                STORE(cell->sequence, pos + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+        else if (diff < 0) {
+            return 0;
+        }
+        else {
+            pos = LOAD(queue->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int queue_pop(Queue *queue, void **data) {
+    unsigned int pos = LOAD(queue->tail, __ATOMIC_RELAXED);
+    while (1) {
+        QueueCell *cell = queue->cells + (pos & queue->mask);
+        unsigned int sequence = LOAD(cell->sequence, __ATOMIC_ACQUIRE);
+        int diff = (int)(sequence - (pos + 1));
+        if (diff == 0) {
+            if (CAS(queue->tail, &pos, pos + 1)) {
+                *data = cell->data;
+                STORE(cell->sequence, pos + queue->mask + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        }
+        else if (diff < 0) {
+            return 0;
+        }
+        else {
+            pos = LOAD(queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef _queue_h_
+#define _queue_h_
+
+// bounded multi-producer / multi-consumer queue that never takes a lock
+
+typedef struct {
+    unsigned int sequence;
+    void *data;
+} QueueCell;
+
+typedef struct {
+    unsigned int mask;
+    unsigned int head;
+    unsigned int tail;
+    QueueCell *cells;
+} Queue;
+
+void queue_alloc(Queue *queue, int capacity);
+void queue_free(Queue *queue);
+int queue_push(Queue *queue, void *data);
+int queue_pop(Queue *queue, void **data);
+
+#endif
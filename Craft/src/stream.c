@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+
+#define LOAD(x, order) __atomic_load_n(&(x), order)
+#define STORE(x, v, order) __atomic_store_n(&(x), v, order)
+
+void stream_alloc(Stream *stream, int capacity) {
+    unsigned int size = 1;
+    while (size < (unsigned int)capacity) {
+        size <<= 1;
+    }
+    stream->mask = size - 1;
+    stream->head = 0;
+    stream->tail = 0;
+    stream->scan = 0;
+    stream->next = 0;
+    stream->data = (char *)malloc(size);
+    stream->line = 0;
+    stream->line_size = 0;
+}
+
+void stream_free(Stream *stream) {
+    free(stream->data);
+    free(stream->line);
+}
+
+int stream_reserve(Stream *stream, char **data) {
+    // producer: the largest free span that does not wrap
+    unsigned int head = stream->head;
+    unsigned int tail = LOAD(stream->tail, __ATOMIC_ACQUIRE);
+    unsigned int size = stream->mask + 1;
+    unsigned int space = size - (head - tail);
+    unsigned int end = size - (head & stream->mask);
+    *data = stream->data + (head & stream->mask);
+    return space < end ? space : end;
+}
+
+void stream_commit(Stream *stream, int length) {
+    STORE(stream->head, stream->head + length, __ATOMIC_RELEASE);
+}
+
+char *stream_line(Stream *stream, int *length) {
+    // consumer: hands the previous line back to the producer and returns
+    // the next complete one, nul terminated, or 0 if none has arrived
+    STORE(stream->tail, stream->next, __ATOMIC_RELEASE);
+    unsigned int head = LOAD(stream->head, __ATOMIC_ACQUIRE);
+    unsigned int start = stream->next;
+    unsigned int size = stream->mask + 1;
+    // bytes before scan were already searched on an earlier call
+    while (stream->scan != head) {
+        unsigned int index = stream->scan & stream->mask;
+        unsigned int count = head - stream->scan;
+        if (count > size - index) {
+            count = size - index;
+        }
+        char *found = memchr(stream->data + index, '\n', count);
+        if (found) {
+            stream->scan += found - (stream->data + index);
+            break;
+        }
+        stream->scan += count;
+    }
+    if (stream->scan == head) {
+        return 0;
+    }
+    unsigned int n = stream->scan - start;
+    stream->scan++;
+    stream->next = stream->scan;
+    *length = n;
+    unsigned int index = start & stream->mask;
+    if (index + n < size) {
+        char *line = stream->data + index;
+        line[n] = '\0';
+        return line;
+    }
+    // the rare line that wraps past the end of the ring is copied out
+    if (stream->line_size < n + 1) {
+        free(stream->line);
+        stream->line_size = n + 1;
+        stream->line = (char *)malloc(stream->line_size);
+    }
+    unsigned int first = size - index;
+    memcpy(stream->line, stream->data + index, first);
+    memcpy(stream->line + first, stream->data, n - first);
+    stream->line[n] = '\0';
+    return stream->line;
+}
@@ -0,0 +1,25 @@
+#ifndef _stream_h_
+#define _stream_h_
+
+// single-producer / single-consumer byte ring split into lines; the
+// producer writes straight into the ring and the consumer reads each line
+// where it lies, without locks or copies
+
+typedef struct {
+    unsigned int mask;
+    unsigned int head;
+    unsigned int tail;
+    unsigned int scan;
+    unsigned int next;
+    char *data;
+    char *line;
+    unsigned int line_size;
+} Stream;
+
+void stream_alloc(Stream *stream, int capacity);
+void stream_free(Stream *stream);
+int stream_reserve(Stream *stream, char **data);
+void stream_commit(Stream *stream, int length);
+char *stream_line(Stream *stream, int *length);
+
+#endif
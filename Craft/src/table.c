@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "table.h"
+
+static unsigned int table_hash(int p, int q) {
+    unsigned int key = (unsigned int)p * 73856093u ^ (unsigned int)q * 19349663u;
+    key = key ^ (key >> 16);
+    key = key * 0x45d9f3bu;
+    key = key ^ (key >> 16);
+    return key;
+}
+
+void table_alloc(Table *table, int mask) {
+    table->mask = mask;
+    table->size = 0;
+    table->data = (TableEntry *)calloc(table->mask + 1, sizeof(TableEntry));
+}
+
+void table_free(Table *table) {
+    free(table->data);
+}
+
+void table_clear(Table *table) {
+    memset(table->data, 0, (table->mask + 1) * sizeof(TableEntry));
+    table->size = 0;
+}
+
+void table_grow(Table *table) {
+    Table new_table;
+    table_alloc(&new_table, (table->mask << 1) | 1);
+    for (unsigned int i = 0; i <= table->mask; i++) {
+        TableEntry *entry = table->data + i;
+        if (!EMPTY_SLOT(entry)) {
+            table_set(&new_table, entry->p, entry->q, entry->value);
+        }
+    }
+    free(table->data);
+    table->mask = new_table.mask;
+    table->size = new_table.size;
+    table->data = new_table.data;
+}
+
+void table_set(Table *table, int p, int q, void *value) {
+    unsigned int index = table_hash(p, q) & table->mask;
+    TableEntry *entry = table->data + index;
+    while (!EMPTY_SLOT(entry)) {
+        if (entry->p == p && entry->q == q) {
+            entry->value = value;
+            return;
+        }
+        index = (index + 1) & table->mask;
+        entry = table->data + index;
+    }
+    if (!value) {
+        return;
+    }
+    entry->p = p;
+    entry->q = q;
+    entry->value = value;
+    table->size++;
+    if (table->size * 2 > table->mask) {
+        table_grow(table);
+    }
+}
+
+void *table_get(Table *table, int p, int q) {
+    unsigned int index = table_hash(p, q) & table->mask;
+    TableEntry *entry = table->data + index;
+    while (!EMPTY_SLOT(entry)) {
+        if (entry->p == p && entry->q == q) {
+            return entry->value;
+        }
+        index = (index + 1) & table->mask;
+        entry = table->data + index;
+    }
+    return 0;
+}
+
+int table_remove(Table *table, int p, int q) {
+    unsigned int index = table_hash(p, q) & table->mask;
+    TableEntry *entry = table->data + index;
+    while (!EMPTY_SLOT(entry)) {
+        if (entry->p == p && entry->q == q) {
+            break;
+        }
+        index = (index + 1) & table->mask;
+        entry = table->data + index;
+    }
+    if (EMPTY_SLOT(entry)) {
+        return 0;
+    }
+    // backward shift deletion keeps probe sequences intact without tombstones
+    unsigned int hole = index;
+    unsigned int next = (hole + 1) & table->mask;
+    while (!EMPTY_SLOT(table->data + next)) {
+        TableEntry *other = table->data + next;
+        unsigned int home = table_hash(other->p, other->q) & table->mask;
+        if (((next - home) & table->mask) >= ((next - hole) & table->mask)) {
+            table->data[hole] = *other;
+            hole = next;
+        }
+        next = (next + 1) & table->mask;
+    }
+    memset(table->data + hole, 0, sizeof(TableEntry));
+    table->size--;
+    return 1;
+}
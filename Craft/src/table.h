@@ -0,0 +1,26 @@
+#ifndef _table_h_
+#define _table_h_
+
+#define EMPTY_SLOT(slot) ((slot)->value == 0)
+
+typedef struct {
+    int p;
+    int q;
+    void *value;
+} TableEntry;
+
+typedef struct {
+    unsigned int mask;
+    unsigned int size;
+    TableEntry *data;
+} Table;
+
+void table_alloc(Table *table, int mask);
+void table_free(Table *table);
+void table_clear(Table *table);
+void table_grow(Table *table);
+void table_set(Table *table, int p, int q, void *value);
+void *table_get(Table *table, int p, int q);
+int table_remove(Table *table, int p, int q);
+
+#endif
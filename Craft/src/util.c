@@ -1,21 +1,10 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <errno.h>
 #include "lodepng.h"
 #include "matrix.h"
 #include "util.h"
 
-int rand_int(int n) {
-    int result;
-    while (n <= (result = rand() / (RAND_MAX / n)));
-    return result;
-}
-
-double rand_double() {
-    return (double)rand() / (double)RAND_MAX;
-}
-
 void update_fps(FPS *fps) {
     fps->frames++;
     double now = glfwGetTime();
@@ -27,21 +16,6 @@ void update_fps(FPS *fps) {
     }
 }
 
-char *load_file(const char *path) {
-    FILE *file = fopen(path, "rb");
-    if (!file) {
-        fprintf(stderr, "fopen %s failed: %d %s\n", path, errno, strerror(errno));
-        exit(1);
-    }
-    fseek(file, 0, SEEK_END);
-    int length = ftell(file);
-    rewind(file);
-    char *data = calloc(length + 1, sizeof(char));
-    fread(data, 1, length, file);
-    fclose(file);
-    return data;
-}
-
 GLuint gen_buffer(GLsizei size, GLfloat *data) {
     GLuint buffer;
     glGenBuffers(1, &buffer);
@@ -147,79 +121,3 @@ void load_png_texture(const char *file_name) {
         GL_UNSIGNED_BYTE, data);
     free(data);
 }
-
-char *tokenize(char *str, const char *delim, char **key) {
-    char *result;
-    if (str == NULL) {
-        str = *key;
-    }
-    str += strspn(str, delim);
-    if (*str == '\0') {
-        return NULL;
-    }
-    result = str;
-    str += strcspn(str, delim);
-    if (*str) {
-        *str++ = '\0';
-    }
-    *key = str;
-    return result;
-}
-
-int char_width(char input) {
-    static const int lookup[128] = {
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-        4, 2, 4, 7, 6, 9, 7, 2, 3, 3, 4, 6, 3, 5, 2, 7,
-        6, 3, 6, 6, 6, 6, 6, 6, 6, 6, 2, 3, 5, 6, 5, 7,
-        8, 6, 6, 6, 6, 6, 6, 6, 6, 4, 6, 6, 5, 8, 8, 6,
-        6, 7, 6, 6, 6, 6, 8,10, 8, 6, 6, 3, 6, 3, 6, 6,
-        4, 7, 6, 6, 6, 6, 5, 6, 6, 2, 5, 5, 2, 9, 6, 6,
-        6, 6, 6, 6, 5, 6, 6, 6, 6, 6, 6, 4, 2, 5, 7, 0
-    };
-    return lookup[input];
-}
-
-int string_width(const char *input) {
-    int result = 0;
-    int length = strlen(input);
-    for (int i = 0; i < length; i++) {
-        result += char_width(input[i]);
-    }
-    return result;
-}
-
-int wrap(const char *input, int max_width, char *output, int max_length) {
-    *output = '\0';
-    char *text = malloc(sizeof(char) * (strlen(input) + 1));
-    strcpy(text, input);
-    int space_width = char_width(' ');
-    int line_number = 0;
-    char *key1, *key2;
-    char *line = tokenize(text, "\r\n", &key1);
-    while (line) {
-        int line_width = 0;
-        char *token = tokenize(line, " ", &key2);
-        while (token) {
-            int token_width = string_width(token);
-            if (line_width) {
-                if (line_width + token_width > max_width) {
-                    line_width = 0;
-                    line_number++;
-                    strncat(output, "\n", max_length - strlen(output) - 1);
-                }
-                else {
-                    strncat(output, " ", max_length - strlen(output) - 1);
-                }
-            }
-            strncat(output, token, max_length - strlen(output) - 1);
-            line_width += token_width + space_width;
-            token = tokenize(NULL, " ", &key2);
-        }
-        line_number++;
-        strncat(output, "\n", max_length - strlen(output) - 1);
-        line = tokenize(NULL, "\r\n", &key1);
-    }
-    free(text);
-    return line_number;
-}
@@ -1,27 +1,124 @@
+#include <stdlib.h>
 #include "config.h"
 #include "noise.h"
 #include "world.h"
 
+#define PAD 1
+#define AREA (CHUNK_SIZE + PAD * 2)
+#define COLUMNS (AREA * AREA)
+#define CLOUD_BOTTOM 64
+#define CLOUD_TOP 72
+
+typedef struct {
+    float x[COLUMNS];
+    float y[COLUMNS];
+    float z[COLUMNS];
+} Samples;
+
+static void fill_samples(
+    Samples *samples, int p, int q, double sx, double sz, float y)
+{
+    // the scaled coordinates the scalar calls were made with, per column
+    for (int dx = -PAD; dx < CHUNK_SIZE + PAD; dx++) {
+        for (int dz = -PAD; dz < CHUNK_SIZE + PAD; dz++) {
+            int i = (dx + PAD) * AREA + (dz + PAD);
+            int x = p * CHUNK_SIZE + dx;
+            int z = q * CHUNK_SIZE + dz;
+            samples->x[i] = x * sx;
+            samples->y[i] = y;
+            samples->z[i] = z * sz;
+        }
+    }
+}
+
+static int terrain_height(float f, float g, int *w) {
+    int mh = g * 32 + 16;
+    int h = f * mh;
+    int t = 12;
+    *w = 1;
+    if (h <= t) {
+        h = t;
+        *w = 2;
+    }
+    return h;
+}
+
+void create_heights(
+    int x, int z, int step, int size, int *heights, int *blocks)
+{
+    // the terrain surface alone at every step-th column of a size x size
+    // square, for far meshes that never need the blocks themselves
+    int count = size * size;
+    float *buffer = (float *)malloc(sizeof(float) * count * 4);
+    float *sx = buffer;
+    float *sz = buffer + count;
+    float *f = buffer + count * 2;
+    float *g = buffer + count * 3;
+    for (int a = 0; a < size; a++) {
+        for (int b = 0; b < size; b++) {
+            sx[a * size + b] = (x + a * step) * 0.01;
+            sz[a * size + b] = (z + b * step) * 0.01;
+        }
+    }
+    simplex2_batch(f, sx, sz, count, 4, 0.5, 2);
+    for (int i = 0; i < count; i++) {
+        sx[i] = -sx[i];
+        sz[i] = -sz[i];
+    }
+    simplex2_batch(g, sx, sz, count, 2, 0.9, 2);
+    for (int i = 0; i < count; i++) {
+        heights[i] = terrain_height(f[i], g[i], blocks + i);
+    }
+    free(buffer);
+}
+
 void create_world(int p, int q, world_func func, void *arg) {
-    int pad = 1;
+    // noise for every column of the padded area is evaluated in batches
+    // up front: a heightmap, the plant and tree fields and a cloud mask
+    Samples samples;
+    float f[COLUMNS];
+    float g[COLUMNS];
+    float grass[COLUMNS];
+    float flowers[COLUMNS];
+    float trees[COLUMNS];
+    float cloud[COLUMNS];
+    unsigned char clouds[COLUMNS] = {0};
+    fill_samples(&samples, p, q, 0.01, 0.01, 0);
+    simplex2_batch(f, samples.x, samples.z, COLUMNS, 4, 0.5, 2);
+    fill_samples(&samples, p, q, -0.01, -0.01, 0);
+    simplex2_batch(g, samples.x, samples.z, COLUMNS, 2, 0.9, 2);
+    if (SHOW_PLANTS) {
+        fill_samples(&samples, p, q, -0.1, 0.1, 0);
+        simplex2_batch(grass, samples.x, samples.z, COLUMNS, 4, 0.8, 2);
+        fill_samples(&samples, p, q, 0.05, -0.05, 0);
+        simplex2_batch(flowers, samples.x, samples.z, COLUMNS, 4, 0.8, 2);
+    }
+    if (SHOW_TREES) {
+        fill_samples(&samples, p, q, 1, 1, 0);
+        simplex2_batch(trees, samples.x, samples.z, COLUMNS, 6, 0.5, 2);
+    }
+    if (SHOW_CLOUDS) {
+        for (int y = CLOUD_BOTTOM; y < CLOUD_TOP; y++) {
+            fill_samples(&samples, p, q, 0.01, 0.01, y * 0.1);
+            simplex3_batch(
+                cloud, samples.x, samples.y, samples.z, COLUMNS, 8, 0.5, 2);
+            for (int i = 0; i < COLUMNS; i++) {
+                clouds[i] |= (cloud[i] > 0.75) << (y - CLOUD_BOTTOM);
+            }
+        }
+    }
+    int pad = PAD;
     for (int dx = -pad; dx < CHUNK_SIZE + pad; dx++) {
         for (int dz = -pad; dz < CHUNK_SIZE + pad; dz++) {
             int flag = 1;
             if (dx < 0 || dz < 0 || dx >= CHUNK_SIZE || dz >= CHUNK_SIZE) {
                 flag = -1;
             }
+            int i = (dx + pad) * AREA + (dz + pad);
             int x = p * CHUNK_SIZE + dx;
             int z = q * CHUNK_SIZE + dz;
-            float f = simplex2(x * 0.01, z * 0.01, 4, 0.5, 2);
-            float g = simplex2(-x * 0.01, -z * 0.01, 2, 0.9, 2);
-            int mh = g * 32 + 16;
-            int h = f * mh;
-            int w = 1;
-            int t = 12;
-            if (h <= t) {
-                h = t;
-                w = 2;
-            }
+            int w;
+            int h = terrain_height(f[i], g[i], &w);
             // sand and grass terrain
             for (int y = 0; y < h; y++) {
                 func(x, y, z, w * flag, arg);
@@ -29,11 +126,11 @@ void create_world(int p, int q, world_func func, void *arg) {
             if (w == 1) {
                 if (SHOW_PLANTS) {
                     // grass
-                    if (simplex2(-x * 0.1, z * 0.1, 4, 0.8, 2) > 0.6) {
+                    if (grass[i] > 0.6) {
                         func(x, h, z, 17 * flag, arg);
                     }
                     // flowers
-                    if (simplex2(x * 0.05, -z * 0.05, 4, 0.8, 2) > 0.7) {
+                    if (flowers[i] > 0.7) {
                         int w = 18 + simplex2(x * 0.1, z * 0.1, 4, 0.8, 2) * 7;
                         func(x, h, z, w * flag, arg);
                     }
@@ -45,7 +142,7 @@ void create_world(int p, int q, world_func func, void *arg) {
                 {
                     ok = 0;
                 }
-                if (ok && simplex2(x, z, 6, 0.5, 2) > 0.84) {
+                if (ok && trees[i] > 0.84) {
                     for (int y = h + 3; y < h + 8; y++) {
                         for (int ox = -3; ox <= 3; ox++) {
                             for (int oz = -3; oz <= 3; oz++) {
@@ -63,13 +160,9 @@ void create_world(int p, int q, world_func func, void *arg) {
                 }
             }
             // clouds
-            if (SHOW_CLOUDS) {
-                for (int y = 64; y < 72; y++) {
-                    if (simplex3(
-                        x * 0.01, y * 0.1, z * 0.01, 8, 0.5, 2) > 0.75)
-                    {
-                        func(x, y, z, 16 * flag, arg);
-                    }
+            for (int y = CLOUD_BOTTOM; y < CLOUD_TOP; y++) {
+                if (clouds[i] & (1 << (y - CLOUD_BOTTOM))) {
+                    func(x, y, z, 16 * flag, arg);
                 }
             }
         }
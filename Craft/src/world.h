@@ -4,5 +4,7 @@
 typedef void (*world_func)(int, int, int, int, void *);
 
 void create_world(int p, int q, world_func func, void *arg);
+void create_heights(
+    int x, int z, int step, int size, int *heights, int *blocks);
 
 #endif